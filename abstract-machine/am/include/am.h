@@ -47,6 +47,8 @@ extern "C" {
 extern   Area        heap;
 void     putch       (char ch);
 void     halt        (int code) __attribute__((__noreturn__));
+void     roi_begin   (const char *name);
+void     roi_end     (void);
 
 // -------------------- IOE: Input/Output Devices --------------------
 bool     ioe_init    (void);
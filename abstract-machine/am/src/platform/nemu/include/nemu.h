@@ -16,6 +16,14 @@
 # error unsupported ISA __ISA__
 #endif
 
+// mark the begin (op = 1) or the end (op = 2) of a region of interest
+#if defined(__ISA_RISCV32__) || defined(__ISA_RISCV64__)
+// slti with rd = zero is a hint for custom use
+# define nemu_roi(op, name) asm volatile("mv a0, %0; slti zero, zero, %1" : :"r"(name), "i"(op) : "a0")
+#else
+# define nemu_roi(op, name)
+#endif
+
 #if defined(__ARCH_X86_NEMU)
 # define DEVICE_BASE 0x0
 #else
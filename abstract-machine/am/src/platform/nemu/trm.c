@@ -21,6 +21,14 @@ void halt(int code) {
   while (1);
 }
 
+void roi_begin(const char *name) {
+  nemu_roi(1, name);
+}
+
+void roi_end() {
+  nemu_roi(2, NULL);
+}
+
 void _trm_init() {
   int ret = main(mainargs);
   halt(ret);
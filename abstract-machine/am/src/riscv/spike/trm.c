@@ -28,6 +28,12 @@ void halt(int code) {
   while (1);
 }
 
+void roi_begin(const char *name) {
+}
+
+void roi_end() {
+}
+
 void _trm_init() {
   int ret = main(mainargs);
   halt(ret);
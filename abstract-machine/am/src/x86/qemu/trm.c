@@ -58,6 +58,12 @@ void halt(int code) {
   while (1) hlt();
 }
 
+void roi_begin(const char *name) {
+}
+
+void roi_end() {
+}
+
 Area __am_heap_init() {
   extern char end;
   outb(0x70, 0x34);
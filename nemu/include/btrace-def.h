@@ -0,0 +1,94 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#ifndef __BTRACE_DEF_H__
+#define __BTRACE_DEF_H__
+
+#include <stdint.h>
+
+// The binary trace starts with a BTraceHeader, followed by blocks.
+// Each block is a BTraceBlock and `size' bytes of records compressed
+// by zlib. Blocks can be decoded independently, since the values
+// used for delta encoding are reset at the beginning of each block.
+//
+// Records start with one byte of its type, and numbers are encoded as
+// LEB128 varints (signed ones are zigzag encoded first):
+//   BTRACE_INST  : pc - (pc + ilen of the last instruction) (signed),
+//                  ilen (1 byte), instruction bytes[ilen]
+//   BTRACE_MEM_* : addr - addr of the last memory access (signed),
+//                  len (1 byte), data
+//   BTRACE_DEV_* : addr, len (1 byte), data, device name ('\0' ended)
+// Memory and device accesses come before the instruction making them.
+// Instruction fetches are only recorded by mtrace.
+
+#define BTRACE_MAGIC 0x43525442u // "BTRC"
+#define BTRACE_VERSION 2
+#define BTRACE_BLOCK_SIZE (256 * 1024) // max size of records in a block
+#define BTRACE_DEV_NAME_MAX 16
+
+enum {
+  BTRACE_INST,
+  BTRACE_MEM_R, BTRACE_MEM_W,
+  BTRACE_DEV_R, BTRACE_DEV_W,
+  BTRACE_MEM_X, // instruction fetch
+};
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t word_size;
+  uint32_t pad;
+} BTraceHeader;
+
+typedef struct {
+  uint32_t raw_size; // size of records before compression
+  uint32_t size;     // size of records after compression
+  uint64_t first_inst; // number of instructions before this block
+  uint64_t nr_inst;
+} BTraceBlock;
+
+static inline uint8_t* btrace_put_uleb(uint8_t *p, uint64_t v) {
+  while (v >= 0x80) {
+    *p ++ = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  *p ++ = v;
+  return p;
+}
+
+static inline uint8_t* btrace_put_sleb(uint8_t *p, int64_t v) {
+  return btrace_put_uleb(p, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static inline uint8_t* btrace_get_uleb(uint8_t *p, uint64_t *v) {
+  uint64_t ret = 0;
+  int shift = 0;
+  while (*p & 0x80) {
+    ret |= (uint64_t)(*p ++ & 0x7f) << shift;
+    shift += 7;
+  }
+  *v = ret | ((uint64_t)*p ++ << shift);
+  return p;
+}
+
+static inline uint8_t* btrace_get_sleb(uint8_t *p, int64_t *v) {
+  uint64_t u;
+  p = btrace_get_uleb(p, &u);
+  *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+  return p;
+}
+
+#endif
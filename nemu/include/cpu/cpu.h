@@ -19,6 +19,7 @@
 #include <common.h>
 
 void cpu_exec(uint64_t n);
+void cpu_exec_ref(uint64_t n);
 
 void set_nemu_state(int state, vaddr_t pc, int halt_ret);
 void invalid_inst(vaddr_t thispc);
@@ -26,4 +27,22 @@ void invalid_inst(vaddr_t thispc);
 #define NEMUTRAP(thispc, code) set_nemu_state(NEMU_END, thispc, code)
 #define INV(thispc) invalid_inst(thispc)
 
+#ifdef CONFIG_FAST_FORWARD
+// no instrumentation works when fast forwarding
+extern bool g_fast_forward;
+#define fast_forwarding() unlikely(g_fast_forward)
+#else
+#define fast_forwarding() false
+#endif
+
+#ifdef CONFIG_ROI
+// operations of the hint which marks regions of interest
+enum { ROI_BEGIN = 1, ROI_END = 2 };
+extern bool g_roi_break; // the piece in execute() is ended by a hint
+void roi_hint(int op, vaddr_t name_addr);
+bool roi_active();
+bool roi_skip();
+void roi_resume();
+#endif
+
 #endif
@@ -17,6 +17,7 @@
 #define __CPU_DECODE_H__
 
 #include <isa.h>
+#include <cpu/cpu.h>
 
 typedef struct Decode {
   vaddr_t pc;
@@ -86,12 +87,37 @@ finish:
 }
 
 
+// --- counters of each instruction for the instruction mix ---
+#ifdef CONFIG_IMIX
+typedef struct InstCounter {
+  const char *name;
+  int cls; // INST_ALU, INST_LOAD, ...
+  uint64_t count;
+  struct InstCounter *next;
+} InstCounter;
+
+void imix_register(InstCounter *c);
+
+// a counter for each INSTPAT, registered when it is first matched,
+// and classified by the fixed bits of its pattern
+#define INSTPAT_COUNT(inst, key, mask) do { \
+  static InstCounter __counter = { .name = str(inst) }; \
+  if (!fast_forwarding() && __counter.count ++ == 0) { \
+    __counter.cls = isa_inst_class(key, mask); \
+    imix_register(&__counter); \
+  } \
+} while (0)
+#else
+#define INSTPAT_COUNT(inst, key, mask)
+#endif
+
 // --- pattern matching wrappers for decode ---
-#define INSTPAT(pattern, ...) do { \
+#define INSTPAT(pattern, name, ...) do { \
   uint64_t key, mask, shift; \
   pattern_decode(pattern, STRLEN(pattern), &key, &mask, &shift); \
   if (((INSTPAT_INST(s) >> shift) & mask) == key) { \
-    INSTPAT_MATCH(s, ##__VA_ARGS__); \
+    INSTPAT_COUNT(name, key << shift, mask << shift); \
+    INSTPAT_MATCH(s, name, ##__VA_ARGS__); \
     goto *(__instpat_end); \
   } \
 } while (0)
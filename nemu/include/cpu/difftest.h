@@ -19,18 +19,29 @@
 #include <common.h>
 #include <difftest-def.h>
 
+#ifdef CONFIG_CTRACE
+void ctrace_store(paddr_t addr, int len, word_t data);
+void ctrace_skip();
+#endif
+
 #ifdef CONFIG_DIFFTEST
 void difftest_skip_ref();
 void difftest_skip_dut(int nr_ref, int nr_dut);
 void difftest_set_patch(void (*fn)(void *arg), void *arg);
 void difftest_step(vaddr_t pc, vaddr_t npc);
+void difftest_sync();
+void difftest_trap();
+void difftest_log_store(paddr_t addr, int len);
 void difftest_detach();
 void difftest_attach();
 #else
-static inline void difftest_skip_ref() {}
+static inline void difftest_skip_ref() { IFDEF(CONFIG_CTRACE, ctrace_skip()); }
 static inline void difftest_skip_dut(int nr_ref, int nr_dut) {}
 static inline void difftest_set_patch(void (*fn)(void *arg), void *arg) {}
 static inline void difftest_step(vaddr_t pc, vaddr_t npc) {}
+static inline void difftest_sync() {}
+static inline void difftest_trap() {}
+static inline void difftest_log_store(paddr_t addr, int len) {}
 static inline void difftest_detach() {}
 static inline void difftest_attach() {}
 #endif
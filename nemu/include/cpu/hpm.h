@@ -0,0 +1,32 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __CPU_HPM_H__
+#define __CPU_HPM_H__
+
+#include <common.h>
+
+// Events counted by the hardware performance monitor counters of the
+// ISA. Models of caches, TLBs or branch predictors add their events here.
+enum { HPM_LOAD, HPM_STORE, HPM_JUMP, HPM_MMIO, NR_HPM_EVENT };
+
+#ifdef CONFIG_HPM_EVENTS
+extern uint64_t g_hpm_event[NR_HPM_EVENT];
+#define hpm_count(e) (g_hpm_event[e] ++)
+#else
+#define hpm_count(e) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#ifndef __CTRACE_DEF_H__
+#define __CTRACE_DEF_H__
+
+#include <common.h>
+
+// The commit trace starts with a CTraceHeader and the image, followed
+// by records. Each record starts with one byte of its type:
+//   CTRACE_INST, CTRACE_SKIP: CTraceInst, instruction bytes[ilen],
+//                             CTraceReg[nr_reg], CTraceStore[nr_store]
+//   CTRACE_CKPT: the registers (reg_size bytes)
+//   CTRACE_END : nothing
+// The first record is always a checkpoint.
+
+#define CTRACE_MAGIC 0x43525443u // "CTRC"
+#define CTRACE_VERSION 1
+
+enum {
+  CTRACE_INST, // an instruction executed by REF
+  CTRACE_SKIP, // an instruction skipped by REF, such as accessing MMIO
+  CTRACE_CKPT, // the whole register state, where REF can start from
+  CTRACE_END,
+};
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t word_size;
+  uint32_t reg_size;
+  uint64_t img_addr;
+  uint64_t img_size;
+} CTraceHeader;
+
+typedef struct __attribute__((packed)) {
+  uint8_t ilen;
+  uint8_t nr_reg; // number of registers changed, except pc
+  uint8_t nr_store;
+  word_t npc;
+} CTraceInst;
+
+typedef struct __attribute__((packed)) {
+  uint8_t idx; // index of the register, viewing CPU_state as word_t[]
+  word_t val;
+} CTraceReg;
+
+typedef struct __attribute__((packed)) {
+  uint8_t len;
+  paddr_t addr;
+  word_t data;
+} CTraceStore;
+
+#endif
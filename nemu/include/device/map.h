@@ -21,6 +21,13 @@
 typedef void(*io_callback_t)(uint32_t, int, bool);
 uint8_t* new_space(int size);
 
+#ifdef CONFIG_DEVICE_STAT
+typedef struct {
+  uint64_t nr_read, nr_write, nr_byte;
+  uint64_t nr_callback, callback_ns; // host time spent in the callback
+} IOStat;
+#endif
+
 typedef struct {
   const char *name;
   // we treat ioaddr_t as paddr_t here
@@ -28,6 +35,7 @@ typedef struct {
   paddr_t high;
   void *space;
   io_callback_t callback;
+  IFDEF(CONFIG_DEVICE_STAT, IOStat stat);
 } IOMap;
 
 static inline bool map_inside(IOMap *map, paddr_t addr) {
@@ -53,4 +61,8 @@ void add_mmio_map(const char *name, paddr_t addr,
 word_t map_read(paddr_t addr, int len, IOMap *map);
 void map_write(paddr_t addr, int len, word_t data, IOMap *map);
 
+#ifdef CONFIG_DEVICE_STAT
+void map_register(IOMap *map);
+#endif
+
 #endif
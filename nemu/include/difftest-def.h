@@ -17,6 +17,8 @@
 #define __DIFFTEST_DEF_H__
 
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 #include <generated/autoconf.h>
 
 enum { DIFFTEST_TO_DUT, DIFFTEST_TO_REF };
@@ -33,4 +35,25 @@ enum { DIFFTEST_TO_DUT, DIFFTEST_TO_REF };
 # error Unsupport ISA
 #endif
 
+// Hash a block of memory, used to compare the memory of DUT and REF.
+// The block is hashed in 8 independent 32-bit lanes, so that the loop
+// can be mapped to SIMD instructions. `len' should be a multiple of 32.
+typedef uint32_t difftest_hash_vec_t __attribute__((vector_size(32)));
+
+static inline uint64_t difftest_hash(const void *buf, size_t len) {
+  const uint32_t k = 0x9e3779b1u;
+  difftest_hash_vec_t h = { 1, 2, 3, 4, 5, 6, 7, 8 }, w;
+  size_t i;
+  for (i = 0; i < len; i += sizeof(w)) {
+    memcpy(&w, (const uint8_t *)buf + i, sizeof(w));
+    h = (h ^ w) * k;
+    h ^= h >> 15;
+  }
+  uint64_t ret = len;
+  for (i = 0; i < sizeof(w) / sizeof(h[0]); i ++) {
+    ret = (ret ^ h[i]) * 0x100000001b3ull;
+  }
+  return ret;
+}
+
 #endif
@@ -36,6 +36,8 @@ word_t isa_reg_str2val(const char *name, bool *success);
 // exec
 struct Decode;
 int isa_exec_once(struct Decode *s);
+enum { INST_ALU, INST_LOAD, INST_STORE, INST_BRANCH, INST_CSR, INST_TRAP, NR_INST_CLASS };
+int isa_inst_class(uint64_t key, uint64_t mask); // the fixed bits of the pattern in INSTPAT
 
 // memory
 enum { MMU_DIRECT, MMU_TRANSLATE, MMU_FAIL };
@@ -34,4 +34,15 @@ static inline bool in_pmem(paddr_t addr) {
 word_t paddr_read(paddr_t addr, int len);
 void paddr_write(paddr_t addr, int len, word_t data);
 
+#ifdef CONFIG_PMEM_DIRTY
+int pmem_dirty_pages(paddr_t *pages, int max);
+#endif
+
+#ifdef CONFIG_HEATMAP
+// checked before calling, since it is on the path of every memory access
+extern bool g_heatmap_on;
+void heatmap_access(char type, paddr_t addr);
+#define heatmap(type, addr) do { if (g_heatmap_on) heatmap_access(type, addr); } while (0)
+#endif
+
 #endif
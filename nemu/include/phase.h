@@ -0,0 +1,72 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __PHASE_H__
+#define __PHASE_H__
+
+#include <common.h>
+
+// Host time spent in each phase of emulation, measured by the time stamp
+// counter. Phases nest, and the time of a phase does not include the ones
+// entered inside it, e.g. the time of MMIO is not counted in the memory
+// phase around it. Everything is compiled out without PHASE_PROF.
+
+#ifdef CONFIG_PHASE_PROF
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PHASE_UNIT "cycles"
+static inline uint64_t phase_tsc() { return __rdtsc(); }
+#else
+#include <time.h>
+#define PHASE_UNIT "ns"
+static inline uint64_t phase_tsc() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+#endif
+
+// the time out of cpu_exec() is counted to PHASE_IDLE and not reported
+enum { PHASE_IDLE, PHASE_LOOP, PHASE_FETCH, PHASE_EXEC, PHASE_MEM, PHASE_MMIO,
+  PHASE_DEVICE, PHASE_TRACE, NR_PHASE };
+
+#define PHASE_MAX_DEPTH 8
+
+extern uint64_t g_phase_time[NR_PHASE];
+extern uint64_t g_phase_last;
+extern int g_phase_stack[PHASE_MAX_DEPTH];
+extern int g_phase_depth; // g_phase_stack[g_phase_depth] is the current phase
+
+static inline void phase_enter(int phase) {
+  uint64_t now = phase_tsc();
+  g_phase_time[g_phase_stack[g_phase_depth]] += now - g_phase_last;
+  g_phase_last = now;
+  g_phase_stack[++ g_phase_depth] = phase;
+}
+
+static inline void phase_exit() {
+  uint64_t now = phase_tsc();
+  g_phase_time[g_phase_stack[g_phase_depth --]] += now - g_phase_last;
+  g_phase_last = now;
+}
+
+#define PHASE_ENTER(phase) phase_enter(phase)
+#define PHASE_EXIT() phase_exit()
+#else
+#define PHASE_ENTER(phase)
+#define PHASE_EXIT()
+#endif
+
+#endif
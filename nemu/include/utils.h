@@ -56,6 +56,18 @@ uint64_t get_time();
 
 #define ANSI_FMT(str, fmt) fmt str ANSI_NONE
 
+#ifdef CONFIG_LOG_ASYNC
+void log_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void log_flush();
+
+#define log_write(...) \
+  do { \
+    extern bool log_enable(); \
+    if (log_enable()) { \
+      log_printf(__VA_ARGS__); \
+    } \
+  } while (0)
+#else
 #define log_write(...) IFDEF(CONFIG_TARGET_NATIVE_ELF, \
   do { \
     extern FILE* log_fp; \
@@ -66,6 +78,7 @@ uint64_t get_time();
     } \
   } while (0) \
 )
+#endif
 
 #define _Log(...) \
   do { \
@@ -73,5 +86,98 @@ uint64_t get_time();
     log_write(__VA_ARGS__); \
   } while (0)
 
+// ----------- symbol -----------
+
+#ifndef CONFIG_TARGET_AM
+const char* elf_sym_name(vaddr_t addr, vaddr_t *start);
+bool elf_sym_lookup(const char *name, vaddr_t *start, word_t *size);
+const char* elf_sec_name(vaddr_t addr);
+const char* elf_range_name(vaddr_t lo, vaddr_t hi);
+#endif
+
+// ----------- trace -----------
+
+#ifdef CONFIG_TRACE
+enum { TRACE_INST = 1, TRACE_DEV = 2, TRACE_MEM = 4, TRACE_FUNC = 8 };
+
+// kinds of trace which are enabled in the current trace window
+extern uint32_t g_trace_on;
+extern vaddr_t g_trace_pc_lo, g_trace_pc_hi;
+#define trace_on(kind, pc) \
+  ((g_trace_on & (kind)) && (pc) >= g_trace_pc_lo && (pc) < g_trace_pc_hi)
+
+bool trace_in_window(uint64_t nr_inst);
+bool trace_next(uint64_t *n);
+bool trace_set_kinds(char *kinds, bool enable);
+bool trace_set_window(const char *range);
+bool trace_set_pc(const char *range);
+void trace_display();
+#endif
+#ifdef CONFIG_MTRACE
+// type is 'r', 'w' or 'x' (instruction fetch)
+void mtrace_access(char type, paddr_t addr, int len, word_t data);
+#define mtrace(type, addr, len, data) \
+  do { if (g_trace_on & TRACE_MEM) mtrace_access(type, addr, len, data); } while (0)
+bool mtrace_set(char *opts);
+void mtrace_display();
+#endif
+
+#ifdef CONFIG_ITRACE
+void itrace_format(char *buf, int size, vaddr_t pc, uint8_t *inst, int ilen);
+#endif
+#ifdef CONFIG_FTRACE
+void ftrace_call(vaddr_t pc, vaddr_t target);
+void ftrace_ret(vaddr_t pc, vaddr_t target);
+void ftrace_jump(vaddr_t pc, vaddr_t target);
+void ftrace_report();
+void ftrace_restart();
+#endif
+#ifdef CONFIG_IRINGBUF
+// only raw instructions are recorded, they are
+// disassembled when the ring buffer is dumped
+typedef struct {
+  vaddr_t pc;
+  int ilen;
+  uint64_t inst;
+} IRingBufEntry;
+
+extern IRingBufEntry iringbuf[];
+extern int iringbuf_tail;
+extern bool iringbuf_full;
+
+// this is called for every instruction, so it is kept inline
+static inline void iringbuf_push(vaddr_t pc, uint64_t inst, int ilen) {
+  IRingBufEntry *e = &iringbuf[iringbuf_tail];
+  e->pc = pc;
+  e->ilen = ilen;
+  e->inst = inst;
+  iringbuf_tail ++;
+  if (iringbuf_tail == CONFIG_IRINGBUF_SIZE) {
+    iringbuf_tail = 0;
+    iringbuf_full = true;
+  }
+}
+void iringbuf_dump();
+#endif
+#ifdef CONFIG_BTRACE
+void btrace_inst(vaddr_t pc, uint8_t *inst, int ilen);
+void btrace_mem(char type, paddr_t addr, int len, word_t data);
+void btrace_dev(bool is_write, paddr_t addr, int len, word_t data, const char *name);
+void btrace_close();
+bool btrace_enabled();
+#endif
+
+// ----------- timeline -----------
+
+#ifdef CONFIG_TIMELINE
+enum { TL_GUEST = 1, TL_DEVICE, TL_HOST }; // tracks in the timeline
+
+uint64_t timeline_now(); // unit: ns
+void timeline_begin(int track, const char *name);
+void timeline_end(int track);
+void timeline_instant(int track, const char *name, uint64_t arg);
+void timeline_span(int track, const char *name, uint64_t start, uint64_t arg);
+void timeline_mmio(const char *name);
+#endif
 
 #endif
@@ -0,0 +1,134 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+
+#ifdef CONFIG_BBV
+// Basic block vectors for SimPoint. A block ends at an instruction
+// whose next pc is not the sequential one. Blocks are identified by
+// their first pc, and numbered from 1 in the order they are first seen.
+// For each interval of about `interval' instructions, a line in the
+// format of SimPoint
+//   T:id:count :id:count ...
+// is written, where count is the number of instructions executed in
+// the block, i.e. executions weighted by the length of the block.
+// Intervals only end at the end of a block.
+
+typedef struct {
+  vaddr_t pc;
+  uint32_t id; // 0 for an empty slot
+  uint64_t count; // in this interval
+} Block;
+
+static FILE *bbv_fp = NULL;
+static uint64_t interval = CONFIG_BBV_INTERVAL;
+static Block *blocks = NULL;
+static uint32_t nr_slot = 0, nr_block = 0;
+static uint32_t *touched = NULL; // slots with non-zero count in this interval
+static uint32_t nr_touched = 0;
+static vaddr_t block_pc = 0;
+static uint64_t block_len = 0, interval_len = 0, nr_interval = 0;
+
+bool bbv_enabled() {
+  return bbv_fp != NULL;
+}
+
+// `size' is a power of 2, take the high bits of the product,
+// since the low bits of aligned pcs are all zero
+static uint32_t find_slot(Block *b, uint32_t size, vaddr_t pc) {
+  uint32_t i = (uint32_t)(pc * 0x9e3779b1u) >> (32 - __builtin_ctz(size));
+  for (; b[i].id != 0 && b[i].pc != pc; i = (i + 1) & (size - 1));
+  return i;
+}
+
+static void grow() {
+  uint32_t size = (nr_slot == 0 ? 4096 : nr_slot * 2);
+  Block *b = calloc(size, sizeof(Block));
+  uint32_t *t = malloc(sizeof(uint32_t) * size);
+  assert(b && t);
+  uint32_t i, n = 0;
+  for (i = 0; i < nr_slot; i ++) {
+    if (blocks[i].id == 0) continue;
+    uint32_t j = find_slot(b, size, blocks[i].pc);
+    b[j] = blocks[i];
+    if (b[j].count != 0) t[n ++] = j;
+  }
+  free(blocks);
+  free(touched);
+  blocks = b;
+  touched = t;
+  nr_slot = size;
+  assert(n == nr_touched);
+}
+
+static void end_interval() {
+  uint32_t i;
+  fputc('T', bbv_fp);
+  for (i = 0; i < nr_touched; i ++) {
+    Block *b = &blocks[touched[i]];
+    fprintf(bbv_fp, ":%" PRIu32 ":%" PRIu64 " ", b->id, b->count);
+    b->count = 0;
+  }
+  fputc('\n', bbv_fp);
+  nr_touched = 0;
+  interval_len = 0;
+  nr_interval ++;
+}
+
+static void end_block() {
+  if ((nr_block + 1) * 2 > nr_slot) grow();
+  uint32_t i = find_slot(blocks, nr_slot, block_pc);
+  Block *b = &blocks[i];
+  if (b->id == 0) { b->pc = block_pc; b->id = ++ nr_block; }
+  if (b->count == 0) touched[nr_touched ++] = i;
+  b->count += block_len;
+  interval_len += block_len;
+  block_len = 0;
+  if (interval_len >= interval) end_interval();
+}
+
+void bbv_exec(vaddr_t pc, vaddr_t snpc, vaddr_t dnpc) {
+  if (bbv_fp == NULL) return;
+  if (block_len == 0) block_pc = pc;
+  block_len ++;
+  if (dnpc != snpc) end_block();
+}
+
+static void bbv_close() {
+  if (block_len > 0) end_block();
+  if (interval_len > 0) end_interval();
+  fclose(bbv_fp);
+  bbv_fp = NULL;
+  Log("%" PRIu64 " intervals of %" PRIu32 " basic blocks are written", nr_interval, nr_block);
+}
+
+void init_bbv(const char *bbv_file, const char *interval_str) {
+  if (bbv_file == NULL) return;
+  if (interval_str != NULL) {
+    char *end;
+    interval = strtoull(interval_str, &end, 0);
+    if (interval == 0 || *end != '\0') {
+      printf(ANSI_FMT("Bad interval '%s'.\n", ANSI_FG_RED), interval_str);
+      exit(1);
+    }
+  }
+  bbv_fp = fopen(bbv_file, "w");
+  Assert(bbv_fp, "Can not open '%s'", bbv_file);
+  setvbuf(bbv_fp, NULL, _IOFBF, 1 << 20);
+  grow();
+  atexit(bbv_close);
+  Log("Basic block vectors of every %" PRIu64 " instructions are written to %s", interval, bbv_file);
+}
+#endif
@@ -16,6 +16,8 @@
 #include <cpu/cpu.h>
 #include <cpu/decode.h>
 #include <cpu/difftest.h>
+#include <cpu/hpm.h>
+#include <phase.h>
 #include <locale.h>
 
 /* The assembly code of instructions executed is only output to the screen
@@ -27,64 +29,163 @@
 
 CPU_state cpu = {};
 uint64_t g_nr_guest_inst = 0;
+#ifdef CONFIG_HPM_EVENTS
+uint64_t g_hpm_event[NR_HPM_EVENT] = {};
+#endif
 static uint64_t g_timer = 0; // unit: us
+static uint64_t timer_start = 0; // of the current cpu_exec()
 static bool g_print_step = false;
 
 void device_update();
 bool scan_wp();
+bool wp_in_use();
+void ctrace_commit(Decode *s);
+void ctrace_flush();
+bool ctrace_enabled();
+void bbv_exec(vaddr_t pc, vaddr_t snpc, vaddr_t dnpc);
+bool bbv_enabled();
+void disasm_cache_stat(uint64_t *hit, uint64_t *miss);
+void profile_next(uint64_t *n);
+void profile_check();
+void profile_report();
+void imix_report();
+void heatmap_report();
+void map_stat_display();
+void stats_next(uint64_t *n);
+void stats_check();
+void stats_json_write(uint64_t host_time);
+void phase_report(uint64_t nr_inst);
+void roi_report();
+void ffwd_next(uint64_t *n);
+void ffwd_check();
+bool ffwd_stat(uint64_t *inst, uint64_t *time);
 
 static void trace_and_difftest(Decode *_this, vaddr_t dnpc) {
-#ifdef CONFIG_ITRACE_COND
-  if (ITRACE_COND) { log_write("%s\n", _this->logbuf); }
+  PHASE_ENTER(PHASE_TRACE);
+#ifdef CONFIG_ITRACE
+  // only disassemble the instruction when it is printed
+  bool log_it = ITRACE_COND && trace_on(TRACE_INST, _this->pc);
+  if (log_it || g_print_step) {
+    itrace_format(_this->logbuf, sizeof(_this->logbuf), _this->pc,
+        (uint8_t *)&_this->isa.inst.val, _this->snpc - _this->pc);
+    if (log_it) { log_write("%s\n", _this->logbuf); }
+    if (g_print_step) { puts(_this->logbuf); }
+  }
 #endif
-  if (g_print_step) { IFDEF(CONFIG_ITRACE, puts(_this->logbuf)); }
+  IFDEF(CONFIG_BTRACE, btrace_inst(_this->pc, (uint8_t *)&_this->isa.inst.val, _this->snpc - _this->pc));
+  IFDEF(CONFIG_CTRACE, ctrace_commit(_this));
+  IFDEF(CONFIG_BBV, bbv_exec(_this->pc, _this->snpc, dnpc));
   IFDEF(CONFIG_DIFFTEST, difftest_step(_this->pc, dnpc));
 
-  if (CONFIG_WATCHPOINT) {
-    if (scan_wp()) {
-      nemu_state.state = NEMU_STOP;
-    }
+#ifdef CONFIG_WATCHPOINT
+  if (scan_wp()) {
+    nemu_state.state = NEMU_STOP;
   }
+#endif
+  PHASE_EXIT();
 }
 
 static void exec_once(Decode *s, vaddr_t pc) {
   s->pc = pc;
   s->snpc = pc;
+  PHASE_ENTER(PHASE_EXEC);
   isa_exec_once(s);
+  PHASE_EXIT();
   cpu.pc = s->dnpc;
-#ifdef CONFIG_ITRACE
-  char *p = s->logbuf;
-  p += snprintf(p, sizeof(s->logbuf), FMT_WORD ":", s->pc);
-  int ilen = s->snpc - s->pc;
-  int i;
-  uint8_t *inst = (uint8_t *)&s->isa.inst.val;
-  for (i = ilen - 1; i >= 0; i --) {
-    p += snprintf(p, 4, " %02x", inst[i]);
-  }
-  int ilen_max = MUXDEF(CONFIG_ISA_x86, 8, 4);
-  int space_len = ilen_max - ilen;
-  if (space_len < 0) space_len = 0;
-  space_len = space_len * 3 + 1;
-  memset(p, ' ', space_len);
-  p += space_len;
-
-  void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte);
-  disassemble(p, s->logbuf + sizeof(s->logbuf) - p,
-      MUXDEF(CONFIG_ISA_x86, s->snpc, s->pc), (uint8_t *)&s->isa.inst.val, ilen);
+  if (s->dnpc != s->snpc) hpm_count(HPM_JUMP);
+}
+
+// a hint of regions of interest ends the piece without stopping NEMU
+#ifdef CONFIG_ROI
+#define piece_end() (nemu_state.state != NEMU_RUNNING || g_roi_break)
+#else
+#define piece_end() (nemu_state.state != NEMU_RUNNING)
 #endif
+
+static void execute_traced(Decode *s, uint64_t n) {
+  for (;n > 0; n --) {
+    exec_once(s, cpu.pc);
+    g_nr_guest_inst ++;
+    IFDEF(CONFIG_IRINGBUF, iringbuf_push(s->pc, s->isa.inst.val, s->snpc - s->pc));
+    trace_and_difftest(s, cpu.pc);
+    if (piece_end()) break;
+    IFDEF(CONFIG_DEVICE, device_update());
+  }
 }
 
-static void execute(uint64_t n) {
-  Decode s;
+// the same as execute_traced() without per-instruction hooks
+static void execute_fast(Decode *s, uint64_t n) {
+  for (;n > 0; n --) {
+    exec_once(s, cpu.pc);
+    g_nr_guest_inst ++;
+    IFDEF(CONFIG_IRINGBUF, iringbuf_push(s->pc, s->isa.inst.val, s->snpc - s->pc));
+    if (piece_end()) break;
+    IFDEF(CONFIG_DEVICE, device_update());
+  }
+}
+
+// the same as execute_fast() without recording the instructions,
+// used when fast forwarding and when NEMU is the REF of difftest
+static void execute_bare(Decode *s, uint64_t n) {
   for (;n > 0; n --) {
-    exec_once(&s, cpu.pc);
+    exec_once(s, cpu.pc);
     g_nr_guest_inst ++;
-    trace_and_difftest(&s, cpu.pc);
-    if (nemu_state.state != NEMU_RUNNING) break;
+    if (piece_end()) break;
     IFDEF(CONFIG_DEVICE, device_update());
   }
 }
 
+static void execute(uint64_t n) {
+  Decode s;
+  bool hooked = g_print_step || MUXDEF(CONFIG_DIFFTEST, true, false) ||
+    MUXDEF(CONFIG_WATCHPOINT, wp_in_use(), false) ||
+    MUXDEF(CONFIG_CTRACE, ctrace_enabled(), false);
+  // instrumentation which can be skipped outside regions of interest
+  bool instrumented = MUXDEF(CONFIG_BTRACE, btrace_enabled(), false) ||
+    MUXDEF(CONFIG_BBV, bbv_enabled(), false);
+  PHASE_ENTER(PHASE_LOOP);
+  // run in pieces, so that the loop is switched
+  // when the trace window opens or closes,
+  // or a region of interest begins or ends,
+  // or the detailed mode begins or ends,
+  // and the profiler takes samples between pieces
+  while (n > 0 && nemu_state.state == NEMU_RUNNING) {
+    uint64_t m = n, start = g_nr_guest_inst;
+    IFDEF(CONFIG_FAST_FORWARD, ffwd_next(&m));
+    if (fast_forwarding()) {
+      // nothing is hooked before switching to the detailed mode
+      execute_bare(&s, m);
+    } else {
+      bool traced = MUXDEF(CONFIG_TRACE, trace_next(&m), false);
+      bool instr = instrumented && !MUXDEF(CONFIG_ROI, roi_skip(), false);
+      IFDEF(CONFIG_PROFILE, profile_next(&m));
+      IFDEF(CONFIG_STATS_JSON, stats_next(&m));
+      if (hooked || instr || traced) execute_traced(&s, m);
+      else execute_fast(&s, m);
+      IFDEF(CONFIG_PROFILE, profile_check());
+      IFDEF(CONFIG_STATS_JSON, stats_check());
+    }
+    IFDEF(CONFIG_ROI, roi_resume());
+    IFDEF(CONFIG_FAST_FORWARD, ffwd_check());
+    n -= g_nr_guest_inst - start;
+  }
+  PHASE_EXIT();
+}
+
+// host time spent in cpu_exec() so far
+uint64_t cpu_exec_time() {
+  return g_timer + (nemu_state.state == NEMU_RUNNING ? get_time() - timer_start : 0);
+}
+
+// used by difftest_exec() when NEMU is the REF: a bare loop without
+// hooks and reports, and always resumed since DUT may roll REF back
+void cpu_exec_ref(uint64_t n) {
+  Decode s;
+  nemu_state.state = NEMU_RUNNING;
+  execute_bare(&s, n);
+  if (nemu_state.state == NEMU_RUNNING) nemu_state.state = NEMU_STOP;
+}
+
 static void statistic() {
   IFNDEF(CONFIG_TARGET_AM, setlocale(LC_NUMERIC, ""));
 #define NUMBERIC_FMT MUXDEF(CONFIG_TARGET_AM, "%", "%'") PRIu64
@@ -92,11 +193,38 @@ static void statistic() {
   Log("total guest instructions = " NUMBERIC_FMT, g_nr_guest_inst);
   if (g_timer > 0) Log("simulation frequency = " NUMBERIC_FMT " inst/s", g_nr_guest_inst * 1000000 / g_timer);
   else Log("Finish running in less than 1 us and can not calculate the simulation frequency");
+#ifdef CONFIG_FAST_FORWARD
+  uint64_t ffwd_inst, ffwd_time;
+  if (ffwd_stat(&ffwd_inst, &ffwd_time)) {
+    uint64_t inst = g_nr_guest_inst - ffwd_inst, time = g_timer - ffwd_time;
+    Log("fast forwarded " NUMBERIC_FMT " instructions in " NUMBERIC_FMT " us", ffwd_inst, ffwd_time);
+    Log("detailed mode: " NUMBERIC_FMT " instructions in " NUMBERIC_FMT " us", inst, time);
+    if (time > 0) Log("simulation frequency in the detailed mode = " NUMBERIC_FMT " inst/s", inst * 1000000 / time);
+  }
+#endif
+  IFDEF(CONFIG_ROI, roi_report());
+  IFDEF(CONFIG_IMIX, imix_report());
+  IFDEF(CONFIG_PROFILE, profile_report());
+  IFDEF(CONFIG_HEATMAP, heatmap_report());
+  IFDEF(CONFIG_DEVICE_STAT, map_stat_display());
+  IFDEF(CONFIG_PHASE_PROF, phase_report(g_nr_guest_inst));
+  IFDEF(CONFIG_STATS_JSON, stats_json_write(g_timer));
+  IFDEF(CONFIG_FTRACE, ftrace_report());
+#ifdef CONFIG_ITRACE
+  uint64_t hit, miss;
+  disasm_cache_stat(&hit, &miss);
+  if (hit + miss > 0) Log("disassembly cache hit rate = %.2f%% (" NUMBERIC_FMT " / " NUMBERIC_FMT ")",
+      hit * 100.0 / (hit + miss), hit, hit + miss);
+#endif
 }
 
 void assert_fail_msg() {
+  IFDEF(CONFIG_IRINGBUF, iringbuf_dump());
+  IFDEF(CONFIG_CTRACE, ctrace_flush());
+  IFDEF(CONFIG_BTRACE, btrace_close());
   isa_reg_display();
   statistic();
+  IFDEF(CONFIG_LOG_ASYNC, log_flush());
 }
 
 /* Simulate how the CPU works. */
@@ -109,9 +237,10 @@ void cpu_exec(uint64_t n) {
     default: nemu_state.state = NEMU_RUNNING;
   }
 
-  uint64_t timer_start = get_time();
+  timer_start = get_time();
 
   execute(n);
+  IFDEF(CONFIG_DIFFTEST, difftest_sync());
 
   uint64_t timer_end = get_time();
   g_timer += timer_end - timer_start;
@@ -120,6 +249,9 @@ void cpu_exec(uint64_t n) {
     case NEMU_RUNNING: nemu_state.state = NEMU_STOP; break;
 
     case NEMU_END: case NEMU_ABORT:
+#ifdef CONFIG_IRINGBUF
+      if (nemu_state.state == NEMU_ABORT || nemu_state.halt_ret != 0) iringbuf_dump();
+#endif
       Log("nemu: %s at pc = " FMT_WORD,
           (nemu_state.state == NEMU_ABORT ? ANSI_FMT("ABORT", ANSI_FG_RED) :
            (nemu_state.halt_ret == 0 ? ANSI_FMT("HIT GOOD TRAP", ANSI_FG_GREEN) :
@@ -128,4 +260,5 @@ void cpu_exec(uint64_t n) {
       // fall through
     case NEMU_QUIT: statistic();
   }
+  IFDEF(CONFIG_LOG_ASYNC, log_flush());
 }
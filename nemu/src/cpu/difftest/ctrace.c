@@ -0,0 +1,122 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <isa.h>
+#include <cpu/decode.h>
+#include <cpu/difftest.h>
+#include <memory/paddr.h>
+#include <ctrace-def.h>
+#include <stddef.h>
+
+#ifdef CONFIG_CTRACE
+#define NR_REG (DIFFTEST_REG_SIZE / sizeof(word_t))
+#define PC_IDX (offsetof(CPU_state, pc) / sizeof(word_t))
+#define MAX_STORE 16
+
+static FILE *ctrace_fp = NULL;
+static CPU_state last; // the state recorded in the trace
+static CTraceStore stores[MAX_STORE];
+static int nr_store = 0;
+static bool is_skip = false;
+static uint64_t nr_inst = 0;
+
+static void ctrace_ckpt() {
+  fputc(CTRACE_CKPT, ctrace_fp);
+  fwrite(&cpu, DIFFTEST_REG_SIZE, 1, ctrace_fp);
+  last = cpu;
+}
+
+bool ctrace_enabled() {
+  return ctrace_fp != NULL;
+}
+
+void ctrace_flush() {
+  if (ctrace_fp != NULL) fflush(ctrace_fp);
+}
+
+static void ctrace_close() {
+  fputc(CTRACE_END, ctrace_fp);
+  fclose(ctrace_fp);
+  ctrace_fp = NULL;
+}
+
+void init_ctrace(const char *ctrace_file, long img_size) {
+  if (ctrace_file == NULL) return;
+
+  ctrace_fp = fopen(ctrace_file, "wb");
+  Assert(ctrace_fp, "Can not open '%s'", ctrace_file);
+  setvbuf(ctrace_fp, NULL, _IOFBF, 1 << 20);
+
+  CTraceHeader h = {
+    .magic = CTRACE_MAGIC, .version = CTRACE_VERSION,
+    .word_size = sizeof(word_t), .reg_size = DIFFTEST_REG_SIZE,
+    .img_addr = RESET_VECTOR, .img_size = img_size,
+  };
+  fwrite(&h, sizeof(h), 1, ctrace_fp);
+  fwrite(guest_to_host(RESET_VECTOR), img_size, 1, ctrace_fp);
+  ctrace_ckpt();
+  atexit(ctrace_close);
+
+  Log("Commit trace is written to %s", ctrace_file);
+}
+
+void ctrace_store(paddr_t addr, int len, word_t data) {
+  if (ctrace_fp == NULL) return;
+  Assert(nr_store < MAX_STORE, "too many memory writes at pc = " FMT_WORD, cpu.pc);
+  stores[nr_store ++] = (CTraceStore) { .len = len, .addr = addr, .data = data };
+}
+
+void ctrace_skip() {
+  is_skip = true;
+}
+
+void ctrace_commit(Decode *s) {
+  if (ctrace_fp == NULL) return;
+
+  uint8_t buf[1 + sizeof(CTraceInst) + sizeof(s->isa) +
+    sizeof(CTraceReg) * NR_REG + sizeof(CTraceStore) * MAX_STORE];
+  uint8_t *p = buf;
+  word_t *now = (word_t *)&cpu;
+  word_t *old = (word_t *)&last;
+  int i, nr_reg = 0;
+  int ilen = s->snpc - s->pc;
+  if (ilen > sizeof(s->isa)) ilen = sizeof(s->isa);
+
+  *p ++ = (is_skip ? CTRACE_SKIP : CTRACE_INST);
+  CTraceInst *inst = (void *)p;
+  p += sizeof(*inst);
+  memcpy(p, &s->isa, ilen);
+  p += ilen;
+  for (i = 0; i < NR_REG; i ++) {
+    if (i != PC_IDX && now[i] != old[i]) {
+      CTraceReg r = { .idx = i, .val = now[i] };
+      memcpy(p, &r, sizeof(r));
+      p += sizeof(r);
+      old[i] = now[i];
+      nr_reg ++;
+    }
+  }
+  memcpy(p, stores, sizeof(stores[0]) * nr_store);
+  p += sizeof(stores[0]) * nr_store;
+  *inst = (CTraceInst) { .ilen = ilen, .nr_reg = nr_reg, .nr_store = nr_store, .npc = cpu.pc };
+  last.pc = cpu.pc;
+  fwrite(buf, p - buf, 1, ctrace_fp);
+
+  nr_store = 0;
+  is_skip = false;
+  if (++ nr_inst % CONFIG_CTRACE_CKPT_INTERVAL == 0) ctrace_ckpt();
+}
+#endif
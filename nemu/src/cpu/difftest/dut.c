@@ -17,7 +17,10 @@
 
 #include <isa.h>
 #include <cpu/cpu.h>
+#include <cpu/difftest.h>
 #include <memory/paddr.h>
+#include <memory/host.h>
+#include <memory/vaddr.h>
 #include <utils.h>
 #include <difftest-def.h>
 
@@ -30,10 +33,410 @@ void (*ref_difftest_raise_intr)(uint64_t NO) = NULL;
 
 static bool is_skip_ref = false;
 static int skip_dut_nr_inst = 0;
+static bool is_detached = false;
+
+static void checkregs(CPU_state *ref, vaddr_t pc) {
+  if (!isa_difftest_checkregs(ref, pc)) {
+    nemu_state.state = NEMU_ABORT;
+    nemu_state.halt_pc = pc;
+    isa_reg_display();
+  }
+}
+
+#ifdef CONFIG_DIFFTEST_MEM
+#define NR_PAGE (CONFIG_MSIZE / PAGE_SIZE)
+
+static int (*ref_difftest_memdirty)(paddr_t *pages, int max) = NULL;
+static void (*ref_difftest_memhash)(paddr_t *pages, int n, uint64_t *hash) = NULL;
+static paddr_t pages[NR_PAGE * 2];
+static uint64_t ref_hash[NR_PAGE * 2];
+static uint32_t page_mark[NR_PAGE]; // to remove duplicated pages
+static uint32_t mark = 0;
+static uint64_t mem_unchecked = 0;
+static vaddr_t mem_from = 0; // pc of the first instruction whose memory is unchecked
+static vaddr_t mem_pc = 0; // pc of the last instruction whose registers are checked
+
+static int dirty_pages() {
+  int n = pmem_dirty_pages(pages, NR_PAGE);
+  if (ref_difftest_memdirty == NULL) return n;
+
+  int nr_ref = ref_difftest_memdirty(pages + n, NR_PAGE);
+  int i, j = n;
+  mark ++;
+  for (i = 0; i < n; i ++) {
+    page_mark[(pages[i] - CONFIG_MBASE) >> PAGE_SHIFT] = mark;
+  }
+  for (i = n; i < n + nr_ref; i ++) {
+    uint32_t idx = (pages[i] - CONFIG_MBASE) >> PAGE_SHIFT;
+    if (idx < NR_PAGE && page_mark[idx] != mark) pages[j ++] = pages[i];
+  }
+  return j;
+}
+
+// compare the pages written by DUT or REF since the last check
+static void checkmem(vaddr_t pc) {
+  bool single = (mem_unchecked <= 1);
+  mem_unchecked = 0;
+  int n = dirty_pages();
+  if (n == 0) return;
+  if (ref_difftest_memhash != NULL) ref_difftest_memhash(pages, n, ref_hash);
+
+  paddr_t bad = 0;
+  uint8_t right = 0, wrong = 0;
+  bool found = false;
+  int i, j;
+  for (i = 0; i < n; i ++) {
+    uint8_t *dut = guest_to_host(pages[i]);
+    if (ref_difftest_memhash != NULL && difftest_hash(dut, PAGE_SIZE) == ref_hash[i]) continue;
+
+    uint8_t ref[PAGE_SIZE];
+    ref_difftest_memcpy(pages[i], ref, PAGE_SIZE, DIFFTEST_TO_DUT);
+    for (j = 0; j < PAGE_SIZE; j ++) {
+      if (ref[j] != dut[j]) break;
+    }
+    if (j < PAGE_SIZE && (!found || pages[i] + j < bad)) {
+      found = true;
+      bad = pages[i] + j;
+      right = ref[j];
+      wrong = dut[j];
+    }
+  }
+
+  if (found) {
+    // memory is only compared every CONFIG_DIFFTEST_MEM_INTERVAL instructions,
+    // so any of the instructions since the last check can be the wrong one
+    if (!single) {
+      Log("memory is different after executing instructions from pc = " FMT_WORD " to pc = " FMT_WORD
+          ", first at address = " FMT_PADDR ", right = 0x%02x, wrong = 0x%02x",
+          mem_from, pc, bad, right, wrong);
+    } else {
+      Log("memory is different after executing instruction at pc = " FMT_WORD
+          ", first at address = " FMT_PADDR ", right = 0x%02x, wrong = 0x%02x",
+          pc, bad, right, wrong);
+    }
+    nemu_state.state = NEMU_ABORT;
+    nemu_state.halt_pc = pc;
+  }
+}
+
+// `n' instructions from `from' to `pc' are executed
+static void mem_step(int n, vaddr_t from, vaddr_t pc) {
+  if (mem_unchecked == 0) mem_from = from;
+  mem_pc = pc;
+  mem_unchecked += n;
+  if (mem_unchecked >= CONFIG_DIFFTEST_MEM_INTERVAL) checkmem(pc);
+}
+#endif
+
+#ifdef CONFIG_DIFFTEST_SYNC_BATCH
+#define BATCH_SIZE CONFIG_DIFFTEST_BATCH_SIZE
+// A batch is checked once it writes BATCH_SIZE times to the memory.
+// The rest of the log is left for instructions writing more than once.
+#define NR_UNDO (BATCH_SIZE * 2)
+
+typedef struct {
+  paddr_t addr;
+  int len;
+  word_t data; // the data before writing
+} MemUndo;
+
+static void (*ref_difftest_exec_until)(uint64_t n, uint64_t pc, uint64_t nr_hit) = NULL;
+static CPU_state agreed; // the last state on which DUT and REF agree
+static CPU_state snapshot[BATCH_SIZE]; // DUT state after each pending instruction
+static int undo_end[BATCH_SIZE]; // end of the undo log of each pending instruction
+static MemUndo undo[NR_UNDO];
+static int nr_pending = 0;
+static int nr_undo = 0;
+
+// this is called before DUT writes to pmem, so that we can
+// roll back the memory of REF when bisecting a batch
+void difftest_log_store(paddr_t addr, int len) {
+  if (is_detached) return;
+  Assert(nr_undo < NR_UNDO, "too many memory writes in a batch at pc = " FMT_WORD, cpu.pc);
+  undo[nr_undo ++] = (MemUndo) { .addr = addr, .len = len, .data = host_read(guest_to_host(addr), len) };
+}
+
+static void batch_reset() {
+  agreed = cpu;
+  nr_pending = 0;
+  nr_undo = 0;
+}
+
+static vaddr_t pending_pc(int i) {
+  return (i == 0 ? agreed.pc : snapshot[i - 1].pc);
+}
+
+static bool ref_agree(CPU_state *ref_r, CPU_state *dut_r) {
+  return memcmp(ref_r, dut_r, DIFFTEST_REG_SIZE) == 0;
+}
+
+// roll back REF to the state after the first `n' pending instructions
+static void ref_rollback(int n) {
+  int i;
+  for (i = nr_undo - 1; i >= (n == 0 ? 0 : undo_end[n - 1]); i --) {
+    ref_difftest_memcpy(undo[i].addr, &undo[i].data, undo[i].len, DIFFTEST_TO_REF);
+  }
+  ref_difftest_regcpy(n == 0 ? &agreed : &snapshot[n - 1], DIFFTEST_TO_REF);
+}
+
+// Find the first pending instruction which behaves differently.
+// Note that the undo log only records the memory written by DUT. If REF
+// writes to some other address after the first different instruction,
+// rolling back can not recover it. This will be a problem only if some
+// instruction before it loads from that address, which is infrequent.
+static void batch_bisect() {
+  CPU_state ref_r;
+  // DUT and REF agree after `lo' pending instructions, but not `hi'
+  int lo = 0, hi = nr_pending;
+  ref_rollback(0);
+  while (hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    ref_difftest_exec(mid - lo);
+    ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+    if (ref_agree(&ref_r, &snapshot[mid - 1])) lo = mid;
+    else {
+      hi = mid;
+      ref_rollback(lo);
+    }
+  }
+
+  ref_difftest_exec(1);
+  ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+
+  // report with the registers of DUT right after the different
+  // instruction, but note that the memory is not rolled back
+  CPU_state dut_r = cpu;
+  cpu = snapshot[lo];
+  checkregs(&ref_r, pending_pc(lo));
+  if (nemu_state.state != NEMU_ABORT) {
+    // the ISA tolerates the difference, or REF just did not
+    // run the batch precisely at first, let REF catch up
+    cpu = dut_r;
+    ref_difftest_exec(nr_pending - hi);
+  }
+}
+
+// Let REF run the whole batch. If REF can run natively until some pc,
+// tell it where the batch ends. This is not precise if REF goes
+// somewhere else, but bisecting only uses ref_difftest_exec().
+static void batch_exec() {
+  if (ref_difftest_exec_until == NULL) {
+    ref_difftest_exec(nr_pending);
+    return;
+  }
+
+  vaddr_t pc = snapshot[nr_pending - 1].pc;
+  uint64_t nr_hit = 0;
+  int i;
+  for (i = 0; i < nr_pending; i ++) {
+    if (snapshot[i].pc == pc) nr_hit ++;
+  }
+  ref_difftest_exec_until(nr_pending, pc, nr_hit);
+}
+
+static void batch_check() {
+  if (nr_pending == 0) return;
+
+  CPU_state ref_r;
+  batch_exec();
+  ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+  if (!ref_agree(&ref_r, &snapshot[nr_pending - 1])) {
+    batch_bisect();
+    if (nemu_state.state == NEMU_ABORT) return;
+  }
+
+  IFDEF(CONFIG_DIFFTEST_MEM, mem_step(nr_pending, pending_pc(0), pending_pc(nr_pending - 1)));
+  agreed = snapshot[nr_pending - 1];
+  nr_pending = 0;
+  nr_undo = 0;
+}
+#endif
+
+#ifdef CONFIG_DIFFTEST_SYNC_ASYNC
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#define RING_SIZE CONFIG_DIFFTEST_RING_SIZE
+// times to poll the commit log before REF goes to sleep
+#define NR_POLL 1024
+
+static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "RING_SIZE should be a power of 2");
+
+enum { COMMIT_INST, COMMIT_SKIP_REF, COMMIT_SKIP_DUT };
+enum { REF_RUNNING, REF_DIVERGED, REF_STOPPED };
+
+typedef struct {
+  int type;
+  vaddr_t pc;
+  int nr_ref, nr_dut; // only for COMMIT_SKIP_DUT
+  CPU_state dut; // DUT state after the instruction
+} Commit;
+
+// The commit log is a single-producer single-consumer ring.
+// `tail' is only written by DUT, and `head' is only written by REF.
+static Commit ring[RING_SIZE];
+static atomic_size_t head = 0;
+static atomic_size_t tail = 0;
+
+static pthread_t ref_thread;
+static pthread_mutex_t ref_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ref_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ref_continue = PTHREAD_COND_INITIALIZER;
+static atomic_bool ref_sleeping = false;
+static atomic_int ref_state = REF_RUNNING;
+
+// these are only accessed by REF thread, until it reports a difference
+static int ref_skip_dut_nr_inst = 0;
+static vaddr_t diverged_pc;
+static CPU_state diverged_ref;
+static Commit *diverged;
+static bool ref_lost = false; // REF can not catch up with DUT
+
+static void ref_wait_commit(size_t h) {
+  int i;
+  for (i = 0; i < NR_POLL; i ++) {
+    if (atomic_load_explicit(&tail, memory_order_acquire) != h) return;
+    sched_yield();
+  }
+
+  pthread_mutex_lock(&ref_lock);
+  atomic_store(&ref_sleeping, true);
+  while (atomic_load(&tail) == h) pthread_cond_wait(&ref_wakeup, &ref_lock);
+  atomic_store(&ref_sleeping, false);
+  pthread_mutex_unlock(&ref_lock);
+}
+
+// the same as difftest_step() in lockstep mode, but
+// report the difference to DUT instead of checking it
+static bool ref_check(Commit *c) {
+  CPU_state ref_r;
+  switch (c->type) {
+    case COMMIT_SKIP_REF:
+      ref_skip_dut_nr_inst = 0;
+      ref_difftest_regcpy(&c->dut, DIFFTEST_TO_REF);
+      return true;
+    case COMMIT_SKIP_DUT:
+      ref_skip_dut_nr_inst += c->nr_dut;
+      while (c->nr_ref -- > 0) {
+        ref_difftest_exec(1);
+      }
+      return true;
+  }
+
+  if (ref_skip_dut_nr_inst > 0) {
+    ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+    if (ref_r.pc == c->dut.pc) {
+      ref_skip_dut_nr_inst = 0;
+      diverged_pc = c->dut.pc;
+    } else {
+      ref_skip_dut_nr_inst --;
+      if (ref_skip_dut_nr_inst > 0) return true;
+      // let DUT report it, since REF thread can not stop NEMU
+      ref_lost = true;
+      diverged_pc = c->pc;
+      diverged_ref = ref_r;
+      diverged = c;
+      return false;
+    }
+  } else {
+    ref_difftest_exec(1);
+    ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
+    diverged_pc = c->pc;
+  }
+
+  if (memcmp(&ref_r, &c->dut, DIFFTEST_REG_SIZE) == 0) return true;
+  diverged_ref = ref_r;
+  diverged = c;
+  return false;
+}
+
+static void *ref_main(void *arg) {
+  size_t h = atomic_load_explicit(&head, memory_order_relaxed);
+  while (true) {
+    ref_wait_commit(h);
+    if (!ref_check(&ring[h % RING_SIZE])) {
+      // let DUT check the difference with the ISA-specific rules,
+      // and sleep until DUT tells whether to go on
+      int state;
+      pthread_mutex_lock(&ref_lock);
+      atomic_store_explicit(&ref_state, REF_DIVERGED, memory_order_release);
+      while ((state = atomic_load(&ref_state)) == REF_DIVERGED) pthread_cond_wait(&ref_continue, &ref_lock);
+      pthread_mutex_unlock(&ref_lock);
+      if (state == REF_STOPPED) return NULL;
+    }
+    h ++;
+    atomic_store_explicit(&head, h, memory_order_release);
+  }
+  return NULL;
+}
+
+static void ref_set_state(int state) {
+  pthread_mutex_lock(&ref_lock);
+  atomic_store_explicit(&ref_state, state, memory_order_release);
+  pthread_cond_signal(&ref_continue);
+  pthread_mutex_unlock(&ref_lock);
+}
+
+// return false if DUT should not send commits any more
+static bool async_check() {
+  int state = atomic_load_explicit(&ref_state, memory_order_acquire);
+  if (state == REF_RUNNING) return true;
+  if (state == REF_STOPPED) return false;
+
+  if (ref_lost) {
+    ref_set_state(REF_STOPPED);
+    panic("can not catch up with ref.pc = " FMT_WORD " at pc = " FMT_WORD, diverged_ref.pc, diverged_pc);
+  }
+
+  // report with the registers of DUT right after the different instruction
+  CPU_state dut_r = cpu;
+  cpu = diverged->dut;
+  checkregs(&diverged_ref, diverged_pc);
+  if (nemu_state.state == NEMU_ABORT) {
+    ref_set_state(REF_STOPPED);
+    return false;
+  }
+  cpu = dut_r;
+  ref_set_state(REF_RUNNING);
+  return true;
+}
+
+// block only when the commit log is full
+static Commit *commit_alloc() {
+  size_t t = atomic_load_explicit(&tail, memory_order_relaxed);
+  while (t - atomic_load_explicit(&head, memory_order_acquire) == RING_SIZE) {
+    if (!async_check()) return NULL;
+    sched_yield();
+  }
+  return &ring[t % RING_SIZE];
+}
+
+static void commit_push() {
+  // Sequentially consistent, so that either REF sees the new commit
+  // before going to sleep, or DUT sees that REF is sleeping.
+  atomic_fetch_add(&tail, 1);
+  if (atomic_load(&ref_sleeping)) {
+    pthread_mutex_lock(&ref_lock);
+    pthread_cond_signal(&ref_wakeup);
+    pthread_mutex_unlock(&ref_lock);
+  }
+}
+
+static void async_drain() {
+  while (atomic_load_explicit(&head, memory_order_acquire) !=
+      atomic_load_explicit(&tail, memory_order_relaxed)) {
+    if (!async_check()) return;
+    sched_yield();
+  }
+}
+#endif
 
 // this is used to let ref skip instructions which
 // can not produce consistent behavior with NEMU
 void difftest_skip_ref() {
+  if (is_detached) return;
+  IFDEF(CONFIG_CTRACE, ctrace_skip());
   is_skip_ref = true;
   // If such an instruction is one of the instruction packing in QEMU
   // (see below), we end the process of catching up with QEMU's pc to
@@ -42,7 +445,8 @@ void difftest_skip_ref() {
   // already write some memory, and the incoming instruction in NEMU
   // will load that memory, we will encounter false negative. But such
   // situation is infrequent.
-  skip_dut_nr_inst = 0;
+  // In asynchronous mode, this is done by REF thread.
+  IFNDEF(CONFIG_DIFFTEST_SYNC_ASYNC, skip_dut_nr_inst = 0);
 }
 
 // this is used to deal with instruction packing in QEMU.
@@ -52,6 +456,18 @@ void difftest_skip_ref() {
 //   Let REF run `nr_ref` instructions first.
 //   We expect that DUT will catch up with REF within `nr_dut` instructions.
 void difftest_skip_dut(int nr_ref, int nr_dut) {
+  if (is_detached) return;
+  IFDEF(CONFIG_DIFFTEST_SYNC_BATCH, batch_check());
+#ifdef CONFIG_DIFFTEST_SYNC_ASYNC
+  if (!async_check()) return;
+  Commit *c = commit_alloc();
+  if (c == NULL) return;
+  c->type = COMMIT_SKIP_DUT;
+  c->nr_ref = nr_ref;
+  c->nr_dut = nr_dut;
+  commit_push();
+  return;
+#endif
   skip_dut_nr_inst += nr_dut;
 
   while (nr_ref -- > 0) {
@@ -78,35 +494,69 @@ void init_difftest(char *ref_so_file, long img_size, int port) {
   ref_difftest_raise_intr = dlsym(handle, "difftest_raise_intr");
   assert(ref_difftest_raise_intr);
 
+#ifdef CONFIG_DIFFTEST_SYNC_BATCH
+  // optional, to let REF run a batch natively
+  ref_difftest_exec_until = dlsym(handle, "difftest_exec_until");
+#endif
+
+#ifdef CONFIG_DIFFTEST_MEM
+  // optional, only pages written by DUT are checked without them
+  ref_difftest_memdirty = dlsym(handle, "difftest_memdirty");
+  ref_difftest_memhash = dlsym(handle, "difftest_memhash");
+#endif
+
   void (*ref_difftest_init)(int) = dlsym(handle, "difftest_init");
   assert(ref_difftest_init);
 
   Log("Differential testing: %s", ANSI_FMT("ON", ANSI_FG_GREEN));
-  Log("The result of every instruction will be compared with %s. "
+  Log("The result of every " MUXDEF(CONFIG_DIFFTEST_SYNC_BATCH,
+        str(CONFIG_DIFFTEST_BATCH_SIZE) " instructions", "instruction") " will be compared with %s"
+      MUXDEF(CONFIG_DIFFTEST_SYNC_ASYNC, " in another thread", "") ". "
       "This will help you a lot for debugging, but also significantly reduce the performance. "
       "If it is not necessary, you can turn it off in menuconfig.", ref_so_file);
 
   ref_difftest_init(port);
+#ifdef CONFIG_DIFFTEST_MEM
+  // pages are compared as a whole, so bytes out of the image should also agree
+  ref_difftest_memcpy(PMEM_LEFT, guest_to_host(PMEM_LEFT), CONFIG_MSIZE, DIFFTEST_TO_REF);
+#else
   ref_difftest_memcpy(RESET_VECTOR, guest_to_host(RESET_VECTOR), img_size, DIFFTEST_TO_REF);
+#endif
   ref_difftest_regcpy(&cpu, DIFFTEST_TO_REF);
-}
-
-static void checkregs(CPU_state *ref, vaddr_t pc) {
-  if (!isa_difftest_checkregs(ref, pc)) {
-    nemu_state.state = NEMU_ABORT;
-    nemu_state.halt_pc = pc;
-    isa_reg_display();
-  }
+  IFDEF(CONFIG_DIFFTEST_SYNC_BATCH, batch_reset());
+#ifdef CONFIG_DIFFTEST_SYNC_ASYNC
+  int ret = pthread_create(&ref_thread, NULL, ref_main, NULL);
+  Assert(ret == 0, "can not create the thread for REF");
+#endif
 }
 
 void difftest_step(vaddr_t pc, vaddr_t npc) {
   CPU_state ref_r;
+  if (is_detached) return;
+
+#ifdef CONFIG_DIFFTEST_SYNC_ASYNC
+  if (!async_check()) return;
+  Commit *c = commit_alloc();
+  if (c == NULL) return;
+  c->type = (is_skip_ref ? COMMIT_SKIP_REF : COMMIT_INST);
+  c->pc = pc;
+  c->dut = cpu;
+  is_skip_ref = false;
+  commit_push();
+  return;
+#endif
+
+#ifdef CONFIG_DIFFTEST_SYNC_BATCH
+  // instructions before the skipped one should be checked first
+  if (is_skip_ref) batch_check();
+#endif
 
   if (skip_dut_nr_inst > 0) {
     ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
     if (ref_r.pc == npc) {
       skip_dut_nr_inst = 0;
       checkregs(&ref_r, npc);
+      IFDEF(CONFIG_DIFFTEST_SYNC_BATCH, batch_reset());
       return;
     }
     skip_dut_nr_inst --;
@@ -119,13 +569,57 @@ void difftest_step(vaddr_t pc, vaddr_t npc) {
     // to skip the checking of an instruction, just copy the reg state to reference design
     ref_difftest_regcpy(&cpu, DIFFTEST_TO_REF);
     is_skip_ref = false;
+    IFDEF(CONFIG_DIFFTEST_SYNC_BATCH, batch_reset());
     return;
   }
 
+#ifdef CONFIG_DIFFTEST_SYNC_BATCH
+  undo_end[nr_pending] = nr_undo;
+  snapshot[nr_pending ++] = cpu;
+  if (nr_pending == BATCH_SIZE || nr_undo >= BATCH_SIZE) batch_check();
+#else
   ref_difftest_exec(1);
   ref_difftest_regcpy(&ref_r, DIFFTEST_TO_DUT);
 
   checkregs(&ref_r, pc);
+  IFDEF(CONFIG_DIFFTEST_MEM, if (nemu_state.state != NEMU_ABORT) mem_step(1, pc, pc));
+#endif
+}
+
+// this is called when NEMU stops, so that
+// no instruction is left unchecked
+void difftest_sync() {
+  if (is_detached) return;
+  IFDEF(CONFIG_DIFFTEST_SYNC_BATCH, batch_check());
+  IFDEF(CONFIG_DIFFTEST_SYNC_ASYNC, async_drain());
+  IFDEF(CONFIG_DIFFTEST_MEM, if (nemu_state.state != NEMU_ABORT && skip_dut_nr_inst == 0) checkmem(mem_pc));
+}
+
+// this is called at the entry of a trap, so that the registers
+// are compared before the trap instruction
+void difftest_trap() {
+  if (is_detached) return;
+  IFDEF(CONFIG_DIFFTEST_SYNC_BATCH, batch_check());
+}
+
+// REF is left behind until it is attached again
+void difftest_detach() {
+  difftest_sync();
+  is_detached = true;
+}
+
+// copy the whole state of DUT to REF, and check from here
+void difftest_attach() {
+  if (!is_detached) return;
+  is_detached = false;
+  is_skip_ref = false;
+  skip_dut_nr_inst = 0;
+  ref_difftest_memcpy(PMEM_LEFT, guest_to_host(PMEM_LEFT), CONFIG_MSIZE, DIFFTEST_TO_REF);
+  ref_difftest_regcpy(&cpu, DIFFTEST_TO_REF);
+  isa_difftest_attach();
+  IFDEF(CONFIG_DIFFTEST_SYNC_BATCH, batch_reset());
+  // clear the dirty pages, they are the same now
+  IFDEF(CONFIG_DIFFTEST_MEM, checkmem(cpu.pc));
 }
 #else
 void init_difftest(char *ref_so_file, long img_size, int port) { }
@@ -17,24 +17,46 @@
 #include <cpu/cpu.h>
 #include <difftest-def.h>
 #include <memory/paddr.h>
+#include <memory/vaddr.h>
+
+void init_mem();
 
 void difftest_memcpy(paddr_t addr, void *buf, size_t n, bool direction) {
-  assert(0);
+  if (direction == DIFFTEST_TO_REF) memcpy(guest_to_host(addr), buf, n);
+  else memcpy(buf, guest_to_host(addr), n);
 }
 
 void difftest_regcpy(void *dut, bool direction) {
-  assert(0);
+  if (direction == DIFFTEST_TO_REF) memcpy(&cpu, dut, DIFFTEST_REG_SIZE);
+  else memcpy(dut, &cpu, DIFFTEST_REG_SIZE);
 }
 
 void difftest_exec(uint64_t n) {
-  assert(0);
+  cpu_exec_ref(n);
 }
 
 void difftest_raise_intr(word_t NO) {
-  assert(0);
+  cpu.pc = isa_raise_intr(NO, cpu.pc);
+}
+
+#ifdef CONFIG_PMEM_DIRTY
+// the following are optional, used to compare the memory
+int difftest_memdirty(paddr_t *pages, int max) {
+  return pmem_dirty_pages(pages, max);
 }
 
+void difftest_memhash(paddr_t *pages, int n, uint64_t *hash) {
+  int i;
+  for (i = 0; i < n; i ++) {
+    hash[i] = difftest_hash(guest_to_host(pages[i]), PAGE_SIZE);
+  }
+}
+#endif
+
 void difftest_init(int port) {
+  /* The memory will be copied from DUT later. */
+  init_mem();
+
   /* Perform ISA dependent initialization. */
   init_isa();
 }
@@ -0,0 +1,102 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <cpu/difftest.h>
+#include <memory/paddr.h>
+
+#ifdef CONFIG_FAST_FORWARD
+// With --fast-forward=N, the first N instructions are run with no
+// instrumentation, i.e. no trace, difftest, watchpoint, profiler or
+// statistics. Then difftest is attached and the rest of the run is in
+// the detailed mode, or with --fast-forward=N,M, NEMU quits after M
+// instructions in the detailed mode. At the switch, the profilers and
+// statistics start from the current instruction, and the instructions
+// and host time of the detailed mode are reported separately.
+
+bool g_fast_forward = false;
+static uint64_t switch_at = 0;
+static uint64_t quit_at = UINT64_MAX;
+static uint64_t ffwd_inst = 0, ffwd_time = 0; // at the switch
+
+extern uint64_t g_nr_guest_inst;
+uint64_t cpu_exec_time();
+void profile_restart();
+void stats_restart();
+void heatmap_restart();
+
+void ffwd_next(uint64_t *n) {
+  uint64_t end = (g_fast_forward ? switch_at : quit_at);
+  uint64_t left = (end > g_nr_guest_inst ? end - g_nr_guest_inst : 0);
+  if (*n > left) *n = left;
+}
+
+void ffwd_check() {
+  if (g_fast_forward && g_nr_guest_inst >= switch_at) {
+    g_fast_forward = false;
+    ffwd_inst = g_nr_guest_inst;
+    ffwd_time = cpu_exec_time();
+    IFDEF(CONFIG_FTRACE, ftrace_restart());
+    IFDEF(CONFIG_PROFILE, profile_restart());
+    IFDEF(CONFIG_STATS_JSON, stats_restart());
+    IFDEF(CONFIG_HEATMAP, heatmap_restart());
+    difftest_attach();
+    Log("Fast forwarded %" PRIu64 " instructions, switch to the detailed mode at pc = " FMT_WORD,
+        g_nr_guest_inst, cpu.pc);
+  }
+  if (g_nr_guest_inst >= quit_at && nemu_state.state == NEMU_RUNNING) {
+    Log("Quit after %" PRIu64 " instructions in the detailed mode", quit_at - switch_at);
+    nemu_state.state = NEMU_QUIT;
+    nemu_state.halt_pc = cpu.pc;
+  }
+}
+
+// instructions and host time before the detailed mode,
+// return false if not fast forwarding at all
+bool ffwd_stat(uint64_t *inst, uint64_t *time) {
+  if (switch_at == 0) return false;
+  *inst = (g_fast_forward ? g_nr_guest_inst : ffwd_inst);
+  *time = (g_fast_forward ? cpu_exec_time() : ffwd_time);
+  return true;
+}
+
+void init_ffwd(const char *arg) {
+  if (arg == NULL) return;
+  char *end;
+  switch_at = strtoull(arg, &end, 0);
+  if (*end == ',') {
+    uint64_t detail = strtoull(end + 1, &end, 0);
+    quit_at = (detail > UINT64_MAX - switch_at ? UINT64_MAX : switch_at + detail);
+  }
+  if (end == arg || *end != '\0') {
+    printf(ANSI_FMT("Expect --fast-forward=N or --fast-forward=N,M.\n", ANSI_FG_RED));
+    exit(1);
+  }
+#ifdef CONFIG_CTRACE
+  bool ctrace_enabled();
+  if (ctrace_enabled()) {
+    // the offline checker can not catch up after the skipped instructions
+    printf(ANSI_FMT("Can not fast forward with the commit trace.\n", ANSI_FG_RED));
+    exit(1);
+  }
+#endif
+  if (switch_at == 0) return;
+  g_fast_forward = true;
+  IFDEF(CONFIG_HEATMAP, g_heatmap_on = false); // until heatmap_restart()
+  difftest_detach();
+  Log("Fast forward %" PRIu64 " instructions with no instrumentation", switch_at);
+}
+#endif
@@ -0,0 +1,246 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <memory/paddr.h>
+
+#ifdef CONFIG_FTRACE
+// Functions are identified by their entry addresses. The shadow call
+// stack refers to nodes in a calling context tree, and instructions
+// executed between two calls or returns are added to the node on the
+// top of the stack. This gives exact exclusive counts for each call
+// path (the folded stacks) and for each function.
+
+#define NR_FUNC_SLOT 4096 // must be a power of 2
+
+typedef struct {
+  vaddr_t addr;
+  const char *name;
+  uint64_t calls;
+  uint64_t incl, excl;
+  int active; // number of frames of this function on the stack
+  bool valid;
+} Func;
+
+typedef struct {
+  int func;
+  int parent, child, sibling;
+  uint64_t self;
+} Node;
+
+typedef struct {
+  int node;
+  uint64_t start; // instruction count at the call
+} Frame;
+
+static Func funcs[NR_FUNC_SLOT];
+static int nr_func = 0;
+static Node *nodes = NULL;
+static int nr_node = 0, max_node = 0;
+static Frame *stack = NULL;
+static int depth = 0, max_depth = 0;
+static uint64_t last = 0; // instruction count at the last call or return
+static uint64_t begin = 0; // instruction count at the start of profiling
+static char *folded_file = NULL;
+
+extern uint64_t g_nr_guest_inst;
+
+static int find_func(vaddr_t addr) {
+  uint32_t h = (uint32_t)(addr * 0x9e3779b1u) >> 4;
+  int i;
+  for (i = h & (NR_FUNC_SLOT - 1); funcs[i].valid; i = (i + 1) & (NR_FUNC_SLOT - 1)) {
+    if (funcs[i].addr == addr) return i;
+  }
+  Assert(nr_func < NR_FUNC_SLOT - 1, "too many functions for ftrace");
+  const char *name = elf_sym_name(addr, NULL);
+  if (name == NULL) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "0x%" PRIx64, (uint64_t)addr);
+    name = strdup(buf);
+  }
+  funcs[i] = (Func) { .addr = addr, .name = name, .valid = true };
+  nr_func ++;
+  return i;
+}
+
+static int new_node(int func, int parent) {
+  if (nr_node == max_node) {
+    max_node = (max_node == 0 ? 1024 : max_node * 2);
+    nodes = realloc(nodes, sizeof(Node) * max_node);
+    assert(nodes);
+  }
+  nodes[nr_node] = (Node) { .func = func, .parent = parent, .child = -1, .sibling = -1 };
+  if (parent >= 0) {
+    nodes[nr_node].sibling = nodes[parent].child;
+    nodes[parent].child = nr_node;
+  }
+  return nr_node ++;
+}
+
+static int child_node(int parent, int func) {
+  int n;
+  for (n = nodes[parent].child; n >= 0; n = nodes[n].sibling) {
+    if (nodes[n].func == func) return n;
+  }
+  return new_node(func, parent);
+}
+
+// add instructions executed since the last event to the top
+static void account(uint64_t now) {
+  Node *top = &nodes[stack[depth - 1].node];
+  top->self += now - last;
+  funcs[top->func].excl += now - last;
+  last = now;
+}
+
+static void push(int func, uint64_t now) {
+  if (depth == max_depth) {
+    max_depth *= 2;
+    stack = realloc(stack, sizeof(Frame) * max_depth);
+    assert(stack);
+  }
+  int node = child_node(stack[depth - 1].node, func);
+  stack[depth ++] = (Frame) { .node = node, .start = now };
+  funcs[func].calls ++;
+  funcs[func].active ++;
+  IFDEF(CONFIG_TIMELINE, timeline_begin(TL_GUEST, funcs[func].name));
+}
+
+static void pop(uint64_t now) {
+  Frame *f = &stack[-- depth];
+  Func *fn = &funcs[nodes[f->node].func];
+  IFDEF(CONFIG_TIMELINE, timeline_end(TL_GUEST));
+  // only count the outermost frame of a recursive function
+  if (-- fn->active == 0) fn->incl += now - f->start;
+}
+
+static void log_event(const char *what, vaddr_t pc, vaddr_t target) {
+  if (!trace_on(TRACE_FUNC, pc)) return;
+  log_write("[ftrace] " FMT_WORD ": %*s%s %s@" FMT_WORD "\n", pc, depth * 2, "",
+      what, funcs[nodes[stack[depth - 1].node].func].name, target);
+}
+
+void ftrace_call(vaddr_t pc, vaddr_t target) {
+  // the call instruction itself belongs to the caller
+  uint64_t now = g_nr_guest_inst + 1;
+  account(now);
+  push(find_func(target), now);
+  log_event("call", pc, target);
+}
+
+void ftrace_ret(vaddr_t pc, vaddr_t target) {
+  uint64_t now = g_nr_guest_inst + 1;
+  account(now);
+  log_event("ret ", pc, target);
+  // the root frame is never popped
+  if (depth > 1) pop(now);
+}
+
+// a jump which is not a call or return, check whether it is a tail call
+void ftrace_jump(vaddr_t pc, vaddr_t target) {
+  vaddr_t start;
+  if (elf_sym_name(target, &start) == NULL || start != target) return;
+  int func = find_func(target);
+  if (func == nodes[stack[depth - 1].node].func) return; // a loop back to the entry
+  uint64_t now = g_nr_guest_inst + 1;
+  account(now);
+  if (depth > 1) pop(now);
+  push(func, now);
+  log_event("tail", pc, target);
+}
+
+// fill `buf' with the entries of the callers, the innermost first
+int ftrace_backtrace(vaddr_t *buf, int n) {
+  int i;
+  for (i = 0; i < n && i < depth - 1; i ++) {
+    buf[i] = funcs[nodes[stack[depth - 2 - i].node].func].addr;
+  }
+  return i;
+}
+
+static void write_folded(FILE *fp, int n, char *path, int len) {
+  int l = len + snprintf(path + len, 4096 - len, "%s%s", (len == 0 ? "" : ";"),
+      funcs[nodes[n].func].name);
+  if (l >= 4096) l = 4095; // too deep, truncated
+  if (nodes[n].self > 0) fprintf(fp, "%s %" PRIu64 "\n", path, nodes[n].self);
+  int c;
+  for (c = nodes[n].child; c >= 0; c = nodes[c].sibling) {
+    write_folded(fp, c, path, l);
+  }
+}
+
+static int cmp_excl(const void *a, const void *b) {
+  uint64_t x = (*(Func **)a)->excl, y = (*(Func **)b)->excl;
+  return (x < y) - (x > y);
+}
+
+// start from now when switching to the detailed mode,
+// instructions which are fast forwarded are not counted
+void ftrace_restart() {
+  if (stack == NULL) return;
+  int i;
+  for (i = 0; i < depth; i ++) stack[i].start = g_nr_guest_inst;
+  last = begin = g_nr_guest_inst;
+}
+
+void ftrace_report() {
+  if (stack == NULL) return;
+  uint64_t now = g_nr_guest_inst;
+  account(now);
+  while (depth > 0) pop(now);
+  uint64_t total = (now > begin ? now - begin : 1);
+
+  Func **sorted = malloc(sizeof(Func *) * nr_func);
+  assert(sorted);
+  int i, n = 0;
+  for (i = 0; i < NR_FUNC_SLOT; i ++) {
+    if (funcs[i].valid) sorted[n ++] = &funcs[i];
+  }
+  qsort(sorted, n, sizeof(Func *), cmp_excl);
+  Log("Top functions by exclusive instructions:");
+  Log("%7s %14s %7s %14s %10s  %s", "excl%", "excl", "incl%", "incl", "calls", "function");
+  for (i = 0; i < n && i < CONFIG_FTRACE_TOP_N; i ++) {
+    Func *f = sorted[i];
+    Log("%6.2f%% %14" PRIu64 " %6.2f%% %14" PRIu64 " %10" PRIu64 "  %s",
+        f->excl * 100.0 / total, f->excl, f->incl * 100.0 / total, f->incl, f->calls, f->name);
+  }
+  free(sorted);
+
+  if (folded_file != NULL) {
+    FILE *fp = fopen(folded_file, "w");
+    Assert(fp, "Can not open '%s'", folded_file);
+    char path[4096];
+    write_folded(fp, 0, path, 0);
+    fclose(fp);
+    Log("Folded stacks are written to %s", folded_file);
+  }
+  free(stack);
+  stack = NULL;
+}
+
+void init_ftrace(char *folded) {
+  folded_file = folded;
+  max_depth = 64;
+  stack = malloc(sizeof(Frame) * max_depth);
+  assert(stack);
+  // the root frame is the code from the reset vector
+  int func = find_func(RESET_VECTOR);
+  stack[depth ++] = (Frame) { .node = new_node(func, -1), .start = 0 };
+  funcs[func].calls = 1;
+  funcs[func].active = 1;
+  IFDEF(CONFIG_TIMELINE, timeline_begin(TL_GUEST, funcs[func].name));
+  last = g_nr_guest_inst;
+}
+#endif
@@ -0,0 +1,83 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/decode.h>
+
+#ifdef CONFIG_IMIX
+// The counters are defined by INSTPAT in the decoder of the ISA,
+// and linked here when they are first matched.
+
+static InstCounter *counters = NULL;
+static int nr_counter = 0;
+
+static const char *class_name[NR_INST_CLASS] = {
+  [INST_ALU] = "alu", [INST_LOAD] = "load", [INST_STORE] = "store",
+  [INST_BRANCH] = "branch", [INST_CSR] = "csr", [INST_TRAP] = "trap",
+};
+
+void imix_register(InstCounter *c) {
+  c->next = counters;
+  counters = c;
+  nr_counter ++;
+}
+
+static int cmp_count(const void *a, const void *b) {
+  uint64_t x = (*(InstCounter **)a)->count, y = (*(InstCounter **)b)->count;
+  return (x < y) - (x > y);
+}
+
+void imix_report() {
+  uint64_t total = 0, class_count[NR_INST_CLASS] = {};
+  InstCounter **sorted = malloc(sizeof(InstCounter *) * (nr_counter + 1));
+  assert(sorted);
+  InstCounter *c;
+  int i, n = 0;
+  for (c = counters; c != NULL; c = c->next) {
+    sorted[n ++] = c;
+    total += c->count;
+    class_count[c->cls] += c->count;
+  }
+  if (total == 0) { free(sorted); return; }
+
+  Log("Instruction mix by class:");
+  for (i = 0; i < NR_INST_CLASS; i ++) {
+    if (class_count[i] == 0) continue;
+    Log("%6.2f%% %14" PRIu64 "  %s", class_count[i] * 100.0 / total, class_count[i], class_name[i]);
+  }
+  qsort(sorted, n, sizeof(InstCounter *), cmp_count);
+  Log("Instruction mix by name:");
+  for (i = 0; i < n; i ++) {
+    Log("%6.2f%% %14" PRIu64 "  %s", sorted[i]->count * 100.0 / total, sorted[i]->count, sorted[i]->name);
+  }
+  free(sorted);
+}
+
+void imix_json(FILE *fp) {
+  uint64_t class_count[NR_INST_CLASS] = {};
+  InstCounter *c;
+  int i;
+  fprintf(fp, "{\"by_name\": {");
+  for (c = counters; c != NULL; c = c->next) {
+    fprintf(fp, "%s\"%s\": %" PRIu64, (c == counters ? "" : ", "), c->name, c->count);
+    class_count[c->cls] += c->count;
+  }
+  fprintf(fp, "}, \"by_class\": {");
+  for (i = 0; i < NR_INST_CLASS; i ++) {
+    fprintf(fp, "%s\"%s\": %" PRIu64, (i == 0 ? "" : ", "), class_name[i], class_count[i]);
+  }
+  fprintf(fp, "}}");
+}
+#endif
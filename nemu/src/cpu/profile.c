@@ -0,0 +1,246 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#ifdef CONFIG_PROFILE
+// Take a sample every `period' instructions, or every time the SIGPROF
+// timer fires. Samples are only taken between the pieces run by
+// execute() in cpu-exec.c, so the loops there are not changed. A sample
+// is the pc to execute next, with the callers from the shadow stack of
+// ftrace if it is enabled. Samples with the same stack are merged into
+// a hash table, and symbolized when they are written at exit.
+
+#define MAX_DEPTH 16
+#define TIMER_SLICE 4096 // instructions between two checks of the timer
+
+typedef struct {
+  uint64_t count;
+  int depth;
+  vaddr_t pc[MAX_DEPTH]; // pc[0] is the sampled pc, others are the callers
+} Sample;
+
+static Sample *table = NULL;
+static uint32_t nr_slot = 0, nr_sample = 0;
+static uint64_t total = 0;
+static char *profile_file = NULL;
+static uint64_t period = CONFIG_PROFILE_PERIOD;
+static uint64_t next_sample = 0;
+static bool use_timer = false;
+static volatile sig_atomic_t timer_fired = 0;
+
+extern uint64_t g_nr_guest_inst;
+
+#ifdef CONFIG_FTRACE
+int ftrace_backtrace(vaddr_t *buf, int n);
+#endif
+
+static uint32_t hash(Sample *s) {
+  uint32_t h = s->depth;
+  int i;
+  for (i = 0; i < s->depth; i ++) h = (h ^ (uint32_t)s->pc[i]) * 0x01000193u;
+  return h;
+}
+
+static Sample* find_slot(Sample *t, uint32_t size, Sample *s) {
+  uint32_t i;
+  for (i = hash(s) & (size - 1); t[i].count != 0; i = (i + 1) & (size - 1)) {
+    if (t[i].depth == s->depth && memcmp(t[i].pc, s->pc, sizeof(vaddr_t) * s->depth) == 0) break;
+  }
+  return &t[i];
+}
+
+static void grow() {
+  uint32_t size = (nr_slot == 0 ? 1024 : nr_slot * 2);
+  Sample *t = calloc(size, sizeof(Sample));
+  assert(t);
+  uint32_t i;
+  for (i = 0; i < nr_slot; i ++) {
+    if (table[i].count != 0) *find_slot(t, size, &table[i]) = table[i];
+  }
+  free(table);
+  table = t;
+  nr_slot = size;
+}
+
+static void take_sample() {
+  Sample s = { .depth = 1, .pc = { cpu.pc } };
+  IFDEF(CONFIG_FTRACE, s.depth += ftrace_backtrace(s.pc + 1, MAX_DEPTH - 1));
+  if ((nr_sample + 1) * 4 > nr_slot * 3) grow();
+  Sample *p = find_slot(table, nr_slot, &s);
+  if (p->count == 0) { *p = s; nr_sample ++; }
+  p->count ++;
+  total ++;
+}
+
+static void sigprof_handler(int sig) {
+  timer_fired = 1;
+}
+
+// reduce `*n' to the number of instructions before the next sample
+void profile_next(uint64_t *n) {
+  if (profile_file == NULL) return;
+  uint64_t left = (use_timer ? TIMER_SLICE : next_sample - g_nr_guest_inst);
+  if (*n > left) *n = left;
+}
+
+// start sampling from now when switching to the detailed mode
+void profile_restart() {
+  if (profile_file == NULL) return;
+  timer_fired = 0;
+  next_sample = g_nr_guest_inst + period;
+}
+
+void profile_check() {
+  if (profile_file == NULL) return;
+  if (use_timer) {
+    if (!timer_fired) return;
+    timer_fired = 0;
+  } else {
+    if (g_nr_guest_inst < next_sample) return;
+    next_sample = g_nr_guest_inst + period;
+  }
+  if (MUXDEF(CONFIG_ROI, roi_active(), true)) take_sample();
+}
+
+static const char* sym_name(vaddr_t addr, vaddr_t *key, char *buf, int size) {
+  vaddr_t start = addr;
+  const char *name = elf_sym_name(addr, &start);
+  if (key != NULL) *key = start;
+  if (name != NULL) return name;
+  snprintf(buf, size, FMT_WORD, addr);
+  return buf;
+}
+
+typedef struct {
+  vaddr_t key;
+  uint64_t count;
+} Flat;
+
+static int cmp_key(const void *a, const void *b) {
+  vaddr_t x = ((Flat *)a)->key, y = ((Flat *)b)->key;
+  return (x > y) - (x < y);
+}
+
+typedef struct {
+  char *line;
+  uint64_t count;
+} Folded;
+
+static int cmp_line(const void *a, const void *b) {
+  return strcmp(((Folded *)a)->line, ((Folded *)b)->line);
+}
+
+static int cmp_count(const void *a, const void *b) {
+  uint64_t x = ((Flat *)a)->count, y = ((Flat *)b)->count;
+  return (x < y) - (x > y);
+}
+
+void profile_report() {
+  if (profile_file == NULL || total == 0) return;
+  if (use_timer) {
+    struct itimerval it = {};
+    setitimer(ITIMER_PROF, &it, NULL);
+  }
+
+  // the flat profile of the sampled functions
+  Flat *flat = malloc(sizeof(Flat) * nr_sample);
+  assert(flat);
+  char buf[32];
+  uint32_t i, n = 0;
+  for (i = 0; i < nr_slot; i ++) {
+    if (table[i].count == 0) continue;
+    sym_name(table[i].pc[0], &flat[n].key, buf, sizeof(buf));
+    flat[n ++].count = table[i].count;
+  }
+  qsort(flat, n, sizeof(Flat), cmp_key);
+  uint32_t m = 0;
+  for (i = 0; i < n; i ++) {
+    if (m > 0 && flat[m - 1].key == flat[i].key) flat[m - 1].count += flat[i].count;
+    else flat[m ++] = flat[i];
+  }
+  qsort(flat, m, sizeof(Flat), cmp_count);
+  Log("Top functions by %" PRIu64 " samples:", total);
+  for (i = 0; i < m && i < CONFIG_PROFILE_TOP_N; i ++) {
+    Log("%6.2f%% %10" PRIu64 "  %s", flat[i].count * 100.0 / total, flat[i].count,
+        sym_name(flat[i].key, NULL, buf, sizeof(buf)));
+  }
+  free(flat);
+
+  // the folded stacks, the outermost caller first,
+  // samples at different pc of the same functions are merged
+  Folded *folded = malloc(sizeof(Folded) * nr_sample);
+  assert(folded);
+  for (i = 0, n = 0; i < nr_slot; i ++) {
+    Sample *s = &table[i];
+    if (s->count == 0) continue;
+    char line[MAX_DEPTH * 64];
+    int j, len = 0;
+    for (j = s->depth - 1; j >= 0 && len < sizeof(line); j --) {
+      len += snprintf(line + len, sizeof(line) - len, "%s%s",
+          sym_name(s->pc[j], NULL, buf, sizeof(buf)), (j == 0 ? "" : ";"));
+    }
+    folded[n ++] = (Folded) { .line = strdup(line), .count = s->count };
+  }
+  qsort(folded, n, sizeof(Folded), cmp_line);
+  FILE *fp = fopen(profile_file, "w");
+  Assert(fp, "Can not open '%s'", profile_file);
+  for (i = 0; i < n; i ++) {
+    if (i + 1 < n && strcmp(folded[i].line, folded[i + 1].line) == 0) {
+      folded[i + 1].count += folded[i].count;
+    } else {
+      fprintf(fp, "%s %" PRIu64 "\n", folded[i].line, folded[i].count);
+    }
+    free(folded[i].line);
+  }
+  free(folded);
+  fclose(fp);
+  Log("Profile is written to %s", profile_file);
+  profile_file = NULL;
+}
+
+// PERIOD is the number of instructions between two samples,
+// or the frequency of the SIGPROF timer with the suffix "hz"
+void init_profile(char *file, const char *period_str) {
+  if (file == NULL) return;
+  if (period_str != NULL) {
+    char *end;
+    period = strtoull(period_str, &end, 0);
+    use_timer = (strcmp(end, "hz") == 0);
+    if (period == 0 || (*end != '\0' && !use_timer)) {
+      printf(ANSI_FMT("Bad profile period '%s'.\n", ANSI_FG_RED), period_str);
+      exit(1);
+    }
+  }
+  profile_file = file;
+  grow();
+  if (use_timer) {
+    struct sigaction sa = { .sa_handler = sigprof_handler, .sa_flags = SA_RESTART };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, NULL);
+    uint64_t us = 1000000 / period;
+    if (us == 0) us = 1;
+    struct itimerval it = { .it_interval = { us / 1000000, us % 1000000 }, .it_value = { us / 1000000, us % 1000000 } };
+    setitimer(ITIMER_PROF, &it, NULL);
+    Log("Profile with SIGPROF at %" PRIu64 " Hz", period);
+  } else {
+    next_sample = g_nr_guest_inst + period;
+    Log("Profile every %" PRIu64 " instructions", period);
+  }
+}
+#endif
@@ -0,0 +1,151 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <cpu/cpu.h>
+#include <memory/paddr.h>
+
+#ifdef CONFIG_ROI
+// Regions of interest are marked by the guest with a hint instruction,
+// see nemu_roi() in abstract-machine. Regions are identified by their
+// names and can be nested. With --roi, tracing and the sampling
+// profiler only work inside a region, and with --roi=fast, the other
+// per-instruction hooks are also skipped outside regions. The other
+// statistics, such as the instruction mix and the heatmap, still cover
+// the whole run.
+
+#define NR_REGION 64
+#define MAX_DEPTH 16
+#define NAME_LEN 32
+
+typedef struct {
+  char name[NAME_LEN];
+  uint64_t entries;
+  uint64_t inst, time;
+} Region;
+
+typedef struct {
+  int region;
+  uint64_t inst, time; // at the begin
+} Frame;
+
+enum { ROI_OFF, ROI_SCOPE, ROI_FAST };
+
+static Region regions[NR_REGION];
+static int nr_region = 0;
+static Frame stack[MAX_DEPTH];
+static int depth = 0;
+static int mode = ROI_OFF;
+bool g_roi_break = false;
+
+extern uint64_t g_nr_guest_inst;
+
+// whether instrumentation should work for the instructions executed now
+bool roi_active() {
+  return mode == ROI_OFF || depth > 0;
+}
+
+// whether the per-instruction hooks can be skipped
+bool roi_skip() {
+  return mode == ROI_FAST && depth == 0;
+}
+
+static void read_name(vaddr_t addr, char *buf) {
+  int i;
+  for (i = 0; i < NAME_LEN - 1 && in_pmem(addr + i); i ++) {
+    buf[i] = *(char *)guest_to_host(addr + i);
+    if (buf[i] == '\0') return;
+  }
+  buf[i] = '\0';
+  if (i == 0) strcpy(buf, "?");
+}
+
+static int find_region(const char *name) {
+  int i;
+  for (i = 0; i < nr_region; i ++) {
+    if (strcmp(regions[i].name, name) == 0) return i;
+  }
+  Assert(nr_region < NR_REGION, "too many regions of interest");
+  strcpy(regions[nr_region].name, name);
+  return nr_region ++;
+}
+
+static void roi_begin(vaddr_t name_addr) {
+  char name[NAME_LEN];
+  read_name(name_addr, name);
+  if (depth == MAX_DEPTH) {
+    Log("Regions of interest are nested too deeply, '%s' is ignored", name);
+    return;
+  }
+  int r = find_region(name);
+  regions[r].entries ++;
+  // the hint itself is not counted
+  stack[depth ++] = (Frame) { .region = r, .inst = g_nr_guest_inst + 1, .time = get_time() };
+}
+
+static void roi_end() {
+  if (depth == 0) {
+    Log("The end of a region of interest is found outside any region");
+    return;
+  }
+  Frame *f = &stack[-- depth];
+  regions[f->region].inst += g_nr_guest_inst - f->inst;
+  regions[f->region].time += get_time() - f->time;
+}
+
+void roi_hint(int op, vaddr_t name_addr) {
+  switch (op) {
+    case ROI_BEGIN: roi_begin(name_addr); break;
+    case ROI_END: roi_end(); break;
+    default: return; // other hints are nops
+  }
+  // end the piece in execute(), so that the instrumentation is switched,
+  // nemu_state is not touched, since a watchpoint may stop NEMU here
+  if (mode != ROI_OFF) g_roi_break = true;
+}
+
+// continue with the next piece
+void roi_resume() {
+  g_roi_break = false;
+}
+
+void roi_report() {
+  if (nr_region == 0) return;
+  // regions which are not ended are counted to now
+  int i;
+  for (i = depth - 1; i >= 0; i --) {
+    regions[stack[i].region].inst += g_nr_guest_inst - stack[i].inst;
+    regions[stack[i].region].time += get_time() - stack[i].time;
+  }
+  depth = 0;
+  Log("Regions of interest:");
+  Log("%10s %14s %14s %14s  %s", "entries", "instructions", "host time(us)", "inst/s", "region");
+  for (i = 0; i < nr_region; i ++) {
+    Region *r = &regions[i];
+    uint64_t freq = (r->time > 0 ? r->inst * 1000000 / r->time : 0);
+    Log("%10" PRIu64 " %14" PRIu64 " %14" PRIu64 " %14" PRIu64 "  %s",
+        r->entries, r->inst, r->time, freq, r->name);
+  }
+}
+
+void init_roi(const char *mode_str) {
+  if (mode_str == NULL) return;
+  if (strcmp(mode_str, "scope") == 0) mode = ROI_SCOPE;
+  else if (strcmp(mode_str, "fast") == 0) mode = ROI_FAST;
+  else {
+    printf(ANSI_FMT("Expect --roi, --roi=scope or --roi=fast.\n", ANSI_FG_RED));
+    exit(1);
+  }
+}
+#endif
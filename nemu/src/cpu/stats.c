@@ -0,0 +1,131 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+
+#ifdef CONFIG_STATS_JSON
+// The statistics are written as JSON lines. A line
+//   {"type": "interval", ...}
+// is written and flushed every STATS_INTERVAL instructions, so that a long
+// run can be watched, and a line
+//   {"type": "final", ...}
+// with the counters of all enabled features is written at exit.
+// `elapsed_us' is the host time since NEMU starts, and `host_time_us'
+// is the one spent in cpu_exec(), as printed by statistic().
+
+static FILE *stats_fp = NULL;
+static uint64_t next_snapshot = 0;
+static uint64_t last_inst = 0, last_time = 0;
+
+extern uint64_t g_nr_guest_inst;
+
+void imix_json(FILE *fp);
+void map_stat_json(FILE *fp);
+void disasm_cache_stat(uint64_t *hit, uint64_t *miss);
+bool ffwd_stat(uint64_t *inst, uint64_t *time);
+
+static uint64_t rate(uint64_t inst, uint64_t us) {
+  return (us > 0 ? inst * 1000000 / us : 0);
+}
+
+// reduce `*n' to the number of instructions before the next snapshot
+void stats_next(uint64_t *n) {
+  if (stats_fp == NULL) return;
+  uint64_t left = next_snapshot - g_nr_guest_inst;
+  if (*n > left) *n = left;
+}
+
+void stats_check() {
+  if (stats_fp == NULL || g_nr_guest_inst < next_snapshot) return;
+  uint64_t now = get_time();
+  fprintf(stats_fp, "{\"type\": \"interval\", \"guest_inst\": %" PRIu64 ", \"elapsed_us\": %" PRIu64
+      ", \"inst_per_sec\": %" PRIu64 "}\n", g_nr_guest_inst, now,
+      rate(g_nr_guest_inst - last_inst, now - last_time));
+  fflush(stats_fp);
+  last_inst = g_nr_guest_inst;
+  last_time = now;
+  next_snapshot = g_nr_guest_inst + CONFIG_STATS_INTERVAL;
+}
+
+// start the intervals from now when switching to the detailed mode
+void stats_restart() {
+  if (stats_fp == NULL) return;
+  last_inst = g_nr_guest_inst;
+  last_time = get_time();
+  next_snapshot = g_nr_guest_inst + CONFIG_STATS_INTERVAL;
+}
+
+static bool first_counter = true;
+
+__attribute__((unused))
+static void counter_key(const char *name) {
+  fprintf(stats_fp, "%s\"%s\": ", (first_counter ? "" : ", "), name);
+  first_counter = false;
+}
+
+static const char* state_name() {
+  switch (nemu_state.state) {
+    case NEMU_RUNNING: return "running";
+    case NEMU_STOP: return "stop";
+    case NEMU_END: return (nemu_state.halt_ret == 0 ? "good trap" : "bad trap");
+    case NEMU_ABORT: return "abort";
+    case NEMU_QUIT: return "quit";
+    default: return "unknown";
+  }
+}
+
+void stats_json_write(uint64_t host_time) {
+  if (stats_fp == NULL) return;
+  fprintf(stats_fp, "{\"type\": \"final\", \"guest_inst\": %" PRIu64 ", \"elapsed_us\": %" PRIu64
+      ", \"host_time_us\": %" PRIu64 ", \"inst_per_sec\": %" PRIu64
+      ", \"state\": \"%s\", \"halt_pc\": %" PRIu64 ", \"halt_ret\": %" PRIu64,
+      g_nr_guest_inst, get_time(), host_time, rate(g_nr_guest_inst, host_time), state_name(),
+      (uint64_t)nemu_state.halt_pc, (uint64_t)nemu_state.halt_ret);
+#ifdef CONFIG_FAST_FORWARD
+  // the part before the detailed mode
+  uint64_t ffwd_inst, ffwd_time;
+  if (ffwd_stat(&ffwd_inst, &ffwd_time)) {
+    fprintf(stats_fp, ", \"ffwd_inst\": %" PRIu64 ", \"ffwd_time_us\": %" PRIu64, ffwd_inst, ffwd_time);
+  }
+#endif
+  fprintf(stats_fp, ", \"counters\": {");
+#ifdef CONFIG_ITRACE
+  uint64_t hit, miss;
+  disasm_cache_stat(&hit, &miss);
+  counter_key("disasm_cache");
+  fprintf(stats_fp, "{\"hit\": %" PRIu64 ", \"miss\": %" PRIu64 "}", hit, miss);
+#endif
+#ifdef CONFIG_IMIX
+  counter_key("imix");
+  imix_json(stats_fp);
+#endif
+#ifdef CONFIG_DEVICE_STAT
+  counter_key("devices");
+  map_stat_json(stats_fp);
+#endif
+  fprintf(stats_fp, "}}\n");
+  fclose(stats_fp);
+  stats_fp = NULL;
+}
+
+void init_stats_json(const char *stats_file) {
+  if (stats_file == NULL) return;
+  stats_fp = fopen(stats_file, "w");
+  Assert(stats_fp, "Can not open '%s'", stats_file);
+  next_snapshot = g_nr_guest_inst + CONFIG_STATS_INTERVAL;
+  last_time = get_time();
+  Log("Statistics are written to %s", stats_file);
+}
+#endif
@@ -0,0 +1,166 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <isa.h>
+#include <cpu/cpu.h>
+
+#ifdef CONFIG_TRACE
+// kinds which are checked for every instruction in cpu-exec.c,
+// others are checked when the event happens
+#define TRACE_PER_INST (TRACE_INST)
+
+static const struct {
+  const char *name;
+  uint32_t kind;
+  bool supported;
+} kind_table[] = {
+  { "inst", TRACE_INST, MUXDEF(CONFIG_ITRACE, true, false) },
+  { "dev" , TRACE_DEV , MUXDEF(CONFIG_DEVICE, true, false) },
+  { "mem" , TRACE_MEM , MUXDEF(CONFIG_MTRACE, true, false) },
+  { "func", TRACE_FUNC, MUXDEF(CONFIG_FTRACE, true, false) },
+};
+
+uint32_t g_trace_on = 0;
+vaddr_t g_trace_pc_lo = 0;
+vaddr_t g_trace_pc_hi = (vaddr_t)-1;
+
+static uint32_t trace_kinds = MUXDEF(CONFIG_ITRACE, TRACE_INST, 0);
+static uint64_t trace_from = CONFIG_TRACE_START;
+static uint64_t trace_to = CONFIG_TRACE_END;
+
+extern uint64_t g_nr_guest_inst;
+
+bool trace_in_window(uint64_t nr_inst) {
+  return nr_inst >= trace_from && nr_inst <= trace_to;
+}
+
+// Return whether the next `*n' instructions should be run with the
+// per-instruction hooks for tracing, and reduce `*n' to the number
+// of instructions before the trace window opens or closes.
+bool trace_next(uint64_t *n) {
+  uint64_t next = g_nr_guest_inst + 1;
+  g_trace_on = 0;
+  if (trace_kinds == 0 || next > trace_to) return false;
+  if (MUXDEF(CONFIG_ROI, !roi_active(), false)) return false;
+  if (next < trace_from) {
+    if (*n > trace_from - next) *n = trace_from - next;
+    return false;
+  }
+  g_trace_on = trace_kinds;
+  if (*n > trace_to - next + 1) *n = trace_to - next + 1;
+  return (trace_kinds & TRACE_PER_INST) != 0;
+}
+
+bool trace_set_kinds(char *kinds, bool enable) {
+  uint32_t mask = 0;
+  char *s, *saveptr;
+  for (s = strtok_r(kinds, ",", &saveptr); s != NULL; s = strtok_r(NULL, ",", &saveptr)) {
+    int i;
+    for (i = 0; i < ARRLEN(kind_table); i ++) {
+      if (!kind_table[i].supported) continue;
+      if (strcmp(s, "all") == 0 || strcmp(s, kind_table[i].name) == 0) {
+        mask |= kind_table[i].kind;
+        if (strcmp(s, "all") != 0) break;
+      }
+    }
+    if (strcmp(s, "all") != 0 && i == ARRLEN(kind_table)) {
+      printf(ANSI_FMT("Unknown or disabled trace '%s'.\n", ANSI_FG_RED), s);
+      return false;
+    }
+  }
+  if (enable) trace_kinds |= mask;
+  else trace_kinds &= ~mask;
+  return true;
+}
+
+static bool parse_range(const char *s, uint64_t *lo, uint64_t *hi) {
+  char *end;
+  *lo = strtoull(s, &end, 0);
+  if (end == s || *end != '-') return false;
+  s = end + 1;
+  if (*s == '\0') { *hi = UINT64_MAX; return true; }
+  *hi = strtoull(s, &end, 0);
+  return end != s && *end == '\0';
+}
+
+// FROM-TO: trace the FROM-th to the TO-th instruction
+bool trace_set_window(const char *range) {
+  uint64_t from, to;
+  if (!parse_range(range, &from, &to)) {
+    printf(ANSI_FMT("Expect FROM-TO, or FROM- for no end.\n", ANSI_FG_RED));
+    return false;
+  }
+  trace_from = from;
+  trace_to = to;
+  return true;
+}
+
+// LO-HI: trace instructions with LO <= pc < HI, or in a function,
+// or "all" for all instructions
+bool trace_set_pc(const char *range) {
+  uint64_t lo, hi;
+  IFNDEF(CONFIG_TARGET_AM, vaddr_t start; word_t size);
+  if (strcmp(range, "all") == 0) {
+    lo = 0;
+    hi = (vaddr_t)-1;
+#ifndef CONFIG_TARGET_AM
+  } else if (elf_sym_lookup(range, &start, &size)) {
+    lo = start;
+    hi = start + size;
+#endif
+  } else if (!parse_range(range, &lo, &hi)) {
+    printf(ANSI_FMT("Expect LO-HI, \"all\" or a function name in the ELF file.\n", ANSI_FG_RED));
+    return false;
+  }
+  g_trace_pc_lo = lo;
+  g_trace_pc_hi = (hi > (vaddr_t)-1 ? (vaddr_t)-1 : hi);
+  return true;
+}
+
+void trace_display() {
+  printf("Tracing:");
+  int i;
+  for (i = 0; i < ARRLEN(kind_table); i ++) {
+    if (!kind_table[i].supported) continue;
+    bool on = trace_kinds & kind_table[i].kind;
+    printf(" %s", on ? ANSI_FMT("+", ANSI_FG_GREEN) : ANSI_FMT("-", ANSI_FG_RED));
+    printf("%s", kind_table[i].name);
+  }
+  printf("\nInstructions: %" PRIu64 " to ", trace_from);
+  if (trace_to == UINT64_MAX) printf("the end\n");
+  else printf("%" PRIu64 "\n", trace_to);
+  printf("PC range: [" FMT_WORD ", " FMT_WORD ")\n", g_trace_pc_lo, g_trace_pc_hi);
+  IFDEF(CONFIG_MTRACE, mtrace_display());
+}
+
+void init_trace(char *kinds, const char *window, const char *pc, char *mtrace_opts) {
+  bool ok = true;
+  if (kinds != NULL) {
+    // --trace=KINDS replaces the default
+    trace_kinds = 0;
+    ok = trace_set_kinds(kinds, true);
+  }
+#ifdef CONFIG_MTRACE
+  if (ok && mtrace_opts != NULL) {
+    ok = mtrace_set(mtrace_opts);
+    trace_kinds |= TRACE_MEM;
+  }
+#endif
+  if (ok && window != NULL) ok = trace_set_window(window);
+  if (ok && pc != NULL) ok = trace_set_pc(pc);
+  if (!ok) exit(1);
+}
+#endif
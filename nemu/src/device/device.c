@@ -16,6 +16,7 @@
 #include <common.h>
 #include <utils.h>
 #include <device/alarm.h>
+#include <phase.h>
 #ifndef CONFIG_TARGET_AM
 #include <SDL2/SDL.h>
 #endif
@@ -35,13 +36,19 @@ void vga_update_screen();
 
 void device_update() {
   static uint64_t last = 0;
+  PHASE_ENTER(PHASE_DEVICE);
   uint64_t now = get_time();
   if (now - last < 1000000 / TIMER_HZ) {
+    PHASE_EXIT();
     return;
   }
   last = now;
 
-  IFDEF(CONFIG_HAS_VGA, vga_update_screen());
+#ifdef CONFIG_HAS_VGA
+  IFDEF(CONFIG_TIMELINE, uint64_t start = timeline_now());
+  vga_update_screen();
+  IFDEF(CONFIG_TIMELINE, timeline_span(TL_HOST, "screen", start, 0));
+#endif
 
 #ifndef CONFIG_TARGET_AM
   SDL_Event event;
@@ -64,6 +71,7 @@ void device_update() {
     }
   }
 #endif
+  PHASE_EXIT();
 }
 
 void sdl_clear_event_queue() {
@@ -17,6 +17,7 @@
 #include <memory/host.h>
 #include <memory/vaddr.h>
 #include <device/map.h>
+#include <cpu/cpu.h>
 
 #define IO_SPACE_MAX (2 * 1024 * 1024)
 
@@ -42,22 +43,105 @@ static void check_bound(IOMap *map, paddr_t addr) {
   }
 }
 
-static void invoke_callback(io_callback_t c, paddr_t offset, int len, bool is_write) {
-  if (c != NULL) { c(offset, len, is_write); }
+#ifdef CONFIG_DEVICE_STAT
+#include <time.h>
+
+#define NR_ALL_MAP 32
+
+// maps of both MMIO and port I/O
+static IOMap *all_maps[NR_ALL_MAP];
+static int nr_all_map = 0;
+
+void map_register(IOMap *map) {
+  assert(nr_all_map < NR_ALL_MAP);
+  all_maps[nr_all_map ++] = map;
 }
 
+static uint64_t get_time_ns() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void count_access(IOMap *map, int len, bool is_write) {
+  if (fast_forwarding()) return;
+  if (is_write) map->stat.nr_write ++;
+  else map->stat.nr_read ++;
+  map->stat.nr_byte += len;
+}
+
+void map_stat_display() {
+  int i;
+  _Log("%-12s %12s %12s %14s %12s %12s\n", "device", "reads", "writes", "bytes", "callbacks", "time (us)");
+  for (i = 0; i < nr_all_map; i ++) {
+    IOStat *s = &all_maps[i]->stat;
+    _Log("%-12s %12" PRIu64 " %12" PRIu64 " %14" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n", all_maps[i]->name,
+        s->nr_read, s->nr_write, s->nr_byte, s->nr_callback, s->callback_ns / 1000);
+  }
+}
+
+void map_stat_json(FILE *fp) {
+  int i;
+  fprintf(fp, "{");
+  for (i = 0; i < nr_all_map; i ++) {
+    IOStat *s = &all_maps[i]->stat;
+    fprintf(fp, "%s\"%s\": {\"reads\": %" PRIu64 ", \"writes\": %" PRIu64 ", \"bytes\": %" PRIu64
+        ", \"callbacks\": %" PRIu64 ", \"callback_us\": %" PRIu64 "}", (i == 0 ? "" : ", "),
+        all_maps[i]->name, s->nr_read, s->nr_write, s->nr_byte, s->nr_callback, s->callback_ns / 1000);
+  }
+  fprintf(fp, "}");
+}
+#endif
+
+static void invoke_callback(IOMap *map, paddr_t offset, int len, bool is_write) {
+  if (map->callback == NULL) return;
+#ifdef CONFIG_DEVICE_STAT
+  // not counted when fast forwarding, the same as count_access()
+  if (fast_forwarding()) {
+    map->callback(offset, len, is_write);
+    return;
+  }
+  uint64_t start = get_time_ns();
+  map->callback(offset, len, is_write);
+  map->stat.nr_callback ++;
+  map->stat.callback_ns += get_time_ns() - start;
+#else
+  map->callback(offset, len, is_write);
+#endif
+}
+
+#ifdef CONFIG_TRACE
+static void dtrace(IOMap *map, paddr_t addr, int len, word_t data, bool is_write) {
+  if (trace_on(TRACE_DEV, cpu.pc)) {
+    log_write("[dtrace] pc = " FMT_WORD ": %s %s at " FMT_PADDR ", len = %d, data = " FMT_WORD "\n",
+        cpu.pc, (is_write ? "write" : "read"), map->name, addr, len, data);
+  }
+}
+#endif
+
 void init_map() {
   io_space = malloc(IO_SPACE_MAX);
   assert(io_space);
   p_space = io_space;
 }
 
+// No instrumentation works when fast forwarding. The trace window is
+// closed then, and the others, which are not built by default, check it.
+// The timeline still shows the devices, since it is about the host time.
+static void trace_access(IOMap *map, paddr_t addr, int len, word_t data, bool is_write) {
+  IFDEF(CONFIG_DEVICE_STAT, count_access(map, len, is_write));
+  IFDEF(CONFIG_TIMELINE, timeline_mmio(map->name));
+  IFDEF(CONFIG_BTRACE, if (!fast_forwarding()) btrace_dev(is_write, addr, len, data, map->name));
+  IFDEF(CONFIG_TRACE, dtrace(map, addr, len, data, is_write));
+}
+
 word_t map_read(paddr_t addr, int len, IOMap *map) {
   assert(len >= 1 && len <= 8);
   check_bound(map, addr);
   paddr_t offset = addr - map->low;
-  invoke_callback(map->callback, offset, len, false); // prepare data to read
+  invoke_callback(map, offset, len, false); // prepare data to read
   word_t ret = host_read(map->space + offset, len);
+  trace_access(map, addr, len, ret, false);
   return ret;
 }
 
@@ -66,5 +150,6 @@ void map_write(paddr_t addr, int len, word_t data, IOMap *map) {
   check_bound(map, addr);
   paddr_t offset = addr - map->low;
   host_write(map->space + offset, len, data);
-  invoke_callback(map->callback, offset, len, true);
+  trace_access(map, addr, len, data, true);
+  invoke_callback(map, offset, len, true);
 }
@@ -15,6 +15,8 @@
 
 #include <device/map.h>
 #include <memory/paddr.h>
+#include <cpu/hpm.h>
+#include <phase.h>
 
 #define NR_MAP 16
 
@@ -49,15 +51,23 @@ void add_mmio_map(const char *name, paddr_t addr, void *space, uint32_t len, io_
     .space = space, .callback = callback };
   Log("Add mmio map '%s' at [" FMT_PADDR ", " FMT_PADDR "]",
       maps[nr_map].name, maps[nr_map].low, maps[nr_map].high);
+  IFDEF(CONFIG_DEVICE_STAT, map_register(&maps[nr_map]));
 
   nr_map ++;
 }
 
 /* bus interface */
 word_t mmio_read(paddr_t addr, int len) {
-  return map_read(addr, len, fetch_mmio_map(addr));
+  PHASE_ENTER(PHASE_MMIO);
+  hpm_count(HPM_MMIO);
+  word_t ret = map_read(addr, len, fetch_mmio_map(addr));
+  PHASE_EXIT();
+  return ret;
 }
 
 void mmio_write(paddr_t addr, int len, word_t data) {
+  PHASE_ENTER(PHASE_MMIO);
+  hpm_count(HPM_MMIO);
   map_write(addr, len, data, fetch_mmio_map(addr));
+  PHASE_EXIT();
 }
@@ -15,3 +15,6 @@
 
 INC_PATH += $(NEMU_HOME)/src/isa/$(GUEST_ISA)/include
 DIRS-y += src/isa/$(GUEST_ISA)
+ifneq ($(filter riscv32 riscv64,$(GUEST_ISA)),)
+DIRS-y += src/isa/riscv-common
+endif
@@ -0,0 +1,83 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <cpu/cpu.h>
+#include <cpu/difftest.h>
+#include <cpu/hpm.h>
+#include "csr.h"
+
+// Shared by riscv32 and riscv64, riscv32 also has the high halves of the
+// counters. Only the counters are implemented for now. There is no timing
+// model, so mcycle counts one cycle for each instruction, and time is the
+// host time in us, the same as the timer device. mhpmcounter3 and above
+// count the events in cpu/hpm.h, or are hardwired to zero.
+
+enum { COUNTER_CYCLE, COUNTER_TIME, COUNTER_INSTRET, COUNTER_HPM, NR_COUNTER = 32 };
+
+static uint64_t offset[NR_COUNTER]; // the value written minus the raw value
+
+extern uint64_t g_nr_guest_inst;
+
+static bool implemented(int i) {
+  return i != COUNTER_TIME && i < COUNTER_HPM + MUXDEF(CONFIG_HPM_EVENTS, NR_HPM_EVENT, 0);
+}
+
+static uint64_t raw_counter(int i) {
+  switch (i) {
+    case COUNTER_CYCLE: case COUNTER_INSTRET: return g_nr_guest_inst;
+    case COUNTER_TIME: return get_time();
+  }
+  return (implemented(i) ? MUXDEF(CONFIG_HPM_EVENTS, g_hpm_event[i - COUNTER_HPM], 0) : 0);
+}
+
+word_t csr_rw(vaddr_t pc, uint32_t addr, int op, word_t src, int rs1) {
+  int i = addr & 0x1f;
+  // the reference does not have the same counters
+  difftest_skip_ref();
+  bool hi = false, ro = false;
+  switch (addr & ~0x1f) {
+#ifndef CONFIG_ISA64
+    case 0xc80: hi = true; // fall through
+#endif
+    case 0xc00: ro = true; break; // cycle, time, instret, hpmcounterN
+#ifndef CONFIG_ISA64
+    case 0xb80: hi = true; // fall through
+#endif
+    case 0xb00: if (i == COUNTER_TIME) goto bad; break; // mcycle, minstret, mhpmcounterN
+    case 0x320: // mcountinhibit and mhpmeventN, they are fixed and writes are ignored
+      if (i == 0) return 0; // mcountinhibit, no counter is inhibited
+      if (i < COUNTER_HPM) goto bad;
+      return (implemented(i) ? i - COUNTER_HPM + 1 : 0);
+    default: goto bad;
+  }
+
+  uint64_t raw = raw_counter(i), val = raw + offset[i];
+  word_t old = (hi ? val >> 32 : val);
+  if (op != CSR_RW && rs1 == 0) return old; // read only
+  if (ro) goto bad;
+  if (!implemented(i)) return old;
+
+  word_t data = (op == CSR_RW ? src : (op == CSR_RS ? old | src : old & ~src));
+  val = MUXDEF(CONFIG_ISA64, data,
+      (hi ? ((uint64_t)data << 32) | (uint32_t)val : (val & ~0xffffffffull) | data));
+  // the write takes effect after this instruction is retired
+  offset[i] = val - raw - (i == COUNTER_CYCLE || i == COUNTER_INSTRET);
+  return old;
+
+bad:
+  INV(pc);
+  return 0;
+}
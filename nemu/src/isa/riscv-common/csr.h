@@ -0,0 +1,25 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#ifndef __RISCV_COMMON_CSR_H__
+#define __RISCV_COMMON_CSR_H__
+
+#include <common.h>
+
+// the operations of csrrw, csrrs and csrrc, the same as funct3
+enum { CSR_RW = 1, CSR_RS, CSR_RC };
+word_t csr_rw(vaddr_t pc, uint32_t addr, int op, word_t src, int rs1);
+
+#endif
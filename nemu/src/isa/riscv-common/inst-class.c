@@ -0,0 +1,32 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+
+#ifdef CONFIG_IMIX
+// shared by riscv32 and riscv64, the class is decided by
+// the major opcode, which is fixed in the pattern of INSTPAT
+int isa_inst_class(uint64_t key, uint64_t mask) {
+  if (BITS(mask, 6, 0) != 0x7f) return INST_TRAP; // inv
+  switch (BITS(key, 6, 2)) {
+    case 0x00: case 0x01: return INST_LOAD;  // LOAD, LOAD-FP
+    case 0x08: case 0x09: return INST_STORE; // STORE, STORE-FP
+    case 0x18: case 0x19: case 0x1b: return INST_BRANCH; // BRANCH, JALR, JAL
+    case 0x1c: // SYSTEM, ecall/ebreak/mret/... have funct3 = 0
+      return (BITS(mask, 14, 12) == 0x7 && BITS(key, 14, 12) != 0 ? INST_CSR : INST_TRAP);
+    default: return INST_ALU;
+  }
+}
+#endif
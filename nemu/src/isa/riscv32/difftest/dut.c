@@ -18,7 +18,13 @@
 #include "../local-include/reg.h"
 
 bool isa_difftest_checkregs(CPU_state *ref_r, vaddr_t pc) {
-  return false;
+  bool ok = true;
+  int i;
+  for (i = 0; i < 32; i ++) {
+    ok &= difftest_check_reg(reg_name(i, 4), pc, ref_r->gpr[i], gpr(i));
+  }
+  ok &= difftest_check_reg("pc", pc, ref_r->pc, cpu.pc);
+  return ok;
 }
 
 void isa_difftest_attach() {
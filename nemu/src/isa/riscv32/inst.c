@@ -21,9 +21,11 @@
 #define R(i) gpr(i)
 #define Mr vaddr_read
 #define Mw vaddr_write
+#define CSR(op, src) R(dest) = csr_rw(s->pc, BITS(imm, 11, 0), op, src, BITS(s->isa.inst.val, 19, 15))
+#define zimm BITS(s->isa.inst.val, 19, 15)
 
 enum {
-  TYPE_I, TYPE_U, TYPE_S,
+  TYPE_I, TYPE_U, TYPE_S, TYPE_J,
   TYPE_N, // none
 };
 
@@ -32,6 +34,8 @@ enum {
 #define immI() do { *imm = SEXT(BITS(i, 31, 20), 12); } while(0)
 #define immU() do { *imm = SEXT(BITS(i, 31, 12), 20) << 12; } while(0)
 #define immS() do { *imm = (SEXT(BITS(i, 31, 25), 7) << 5) | BITS(i, 11, 7); } while(0)
+#define immJ() do { *imm = (SEXT(BITS(i, 31, 31), 1) << 20) | (BITS(i, 19, 12) << 12) | \
+                           (BITS(i, 20, 20) << 11) | (BITS(i, 30, 21) << 1); } while(0)
 
 static void decode_operand(Decode *s, int *dest, word_t *src1, word_t *src2, word_t *imm, int type) {
   uint32_t i = s->isa.inst.val;
@@ -43,9 +47,23 @@ static void decode_operand(Decode *s, int *dest, word_t *src1, word_t *src2, wor
     case TYPE_I: src1R();          immI(); break;
     case TYPE_U:                   immU(); break;
     case TYPE_S: src1R(); src2R(); immS(); break;
+    case TYPE_J:                   immJ(); break;
   }
 }
 
+#ifdef CONFIG_FTRACE
+// ra (x1) or t0 (x5) is the link register of a call,
+// and a jalr to the link register is a return
+static void ftrace_jump_to(Decode *s, int rd) {
+  if (fast_forwarding()) return;
+  int rs1 = BITS(s->isa.inst.val, 19, 15);
+  bool is_jalr = (BITS(s->isa.inst.val, 6, 0) == 0x67);
+  if (rd == 1 || rd == 5) ftrace_call(s->pc, s->dnpc);
+  else if (rd == 0 && is_jalr && (rs1 == 1 || rs1 == 5)) ftrace_ret(s->pc, s->dnpc);
+  else if (rd == 0) ftrace_jump(s->pc, s->dnpc);
+}
+#endif
+
 static int decode_exec(Decode *s) {
   int dest = 0;
   word_t src1 = 0, src2 = 0, imm = 0;
@@ -61,7 +79,18 @@ static int decode_exec(Decode *s) {
   INSTPAT("??????? ????? ????? ??? ????? 01101 11", lui    , U, R(dest) = imm);
   INSTPAT("??????? ????? ????? 010 ????? 00000 11", lw     , I, R(dest) = Mr(src1 + imm, 4));
   INSTPAT("??????? ????? ????? 010 ????? 01000 11", sw     , S, Mw(src1 + imm, 4, src2));
+  INSTPAT("??????? ????? ????? ??? ????? 11011 11", jal    , J, R(dest) = s->snpc; s->dnpc = s->pc + imm;
+      IFDEF(CONFIG_FTRACE, ftrace_jump_to(s, dest)));
+  INSTPAT("??????? ????? ????? 000 ????? 11001 11", jalr   , I, R(dest) = s->snpc; s->dnpc = (src1 + imm) & ~1;
+      IFDEF(CONFIG_FTRACE, ftrace_jump_to(s, dest)));
 
+  INSTPAT("??????? ????? ????? 001 ????? 11100 11", csrrw  , I, CSR(CSR_RW, src1));
+  INSTPAT("??????? ????? ????? 010 ????? 11100 11", csrrs  , I, CSR(CSR_RS, src1));
+  INSTPAT("??????? ????? ????? 011 ????? 11100 11", csrrc  , I, CSR(CSR_RC, src1));
+  INSTPAT("??????? ????? ????? 101 ????? 11100 11", csrrwi , I, CSR(CSR_RW, zimm));
+  INSTPAT("??????? ????? ????? 110 ????? 11100 11", csrrsi , I, CSR(CSR_RS, zimm));
+  INSTPAT("??????? ????? ????? 111 ????? 11100 11", csrrci , I, CSR(CSR_RC, zimm));
+  INSTPAT("??????? ????? 00000 010 00000 00100 11", roi    , I, IFDEF(CONFIG_ROI, roi_hint(imm, R(10)))); // slti zero, zero, op
   INSTPAT("0000000 00001 00000 000 00000 11100 11", ebreak , N, NEMUTRAP(s->pc, R(10))); // R(10) is $a0
   INSTPAT("??????? ????? ????? ??? ????? ????? ??", inv    , N, INV(s->pc));
   INSTPAT_END();
@@ -14,8 +14,11 @@
 ***************************************************************************************/
 
 #include <isa.h>
+#include <cpu/difftest.h>
 
 word_t isa_raise_intr(word_t NO, vaddr_t epc) {
+  difftest_trap();
+  IFDEF(CONFIG_TIMELINE, timeline_instant(TL_GUEST, "trap", NO));
   /* TODO: Trigger an interrupt/exception with ``NO''.
    * Then return the address of the interrupt/exception vector.
    */
@@ -21,6 +21,8 @@
 #define R(i) gpr(i)
 #define Mr vaddr_read
 #define Mw vaddr_write
+#define CSR(op, src) R(dest) = csr_rw(s->pc, BITS(imm, 11, 0), op, src, BITS(s->isa.inst.val, 19, 15))
+#define zimm BITS(s->isa.inst.val, 19, 15)
 
 enum {
   TYPE_I, TYPE_U, TYPE_S,
@@ -62,6 +64,13 @@ static int decode_exec(Decode *s) {
   INSTPAT("??????? ????? ????? 011 ????? 00000 11", ld     , I, R(dest) = Mr(src1 + imm, 8));
   INSTPAT("??????? ????? ????? 011 ????? 01000 11", sd     , S, Mw(src1 + imm, 8, src2));
 
+  INSTPAT("??????? ????? ????? 001 ????? 11100 11", csrrw  , I, CSR(CSR_RW, src1));
+  INSTPAT("??????? ????? ????? 010 ????? 11100 11", csrrs  , I, CSR(CSR_RS, src1));
+  INSTPAT("??????? ????? ????? 011 ????? 11100 11", csrrc  , I, CSR(CSR_RC, src1));
+  INSTPAT("??????? ????? ????? 101 ????? 11100 11", csrrwi , I, CSR(CSR_RW, zimm));
+  INSTPAT("??????? ????? ????? 110 ????? 11100 11", csrrsi , I, CSR(CSR_RS, zimm));
+  INSTPAT("??????? ????? ????? 111 ????? 11100 11", csrrci , I, CSR(CSR_RC, zimm));
+  INSTPAT("??????? ????? 00000 010 00000 00100 11", roi    , I, IFDEF(CONFIG_ROI, roi_hint(imm, R(10)))); // slti zero, zero, op
   INSTPAT("0000000 00001 00000 000 00000 11100 11", ebreak , N, NEMUTRAP(s->pc, R(10))); // R(10) is $a0
   INSTPAT("??????? ????? ????? ??? ????? ????? ??", inv    , N, INV(s->pc));
   INSTPAT_END();
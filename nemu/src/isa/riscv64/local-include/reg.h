@@ -30,4 +30,6 @@ static inline const char* reg_name(int idx, int width) {
   return regs[check_reg_idx(idx)];
 }
 
+#include "../../riscv-common/csr.h"
+
 #endif
@@ -0,0 +1,158 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <isa.h>
+#include <memory/paddr.h>
+#include <memory/vaddr.h>
+
+#ifdef CONFIG_HEATMAP
+// Count reads, writes and fetches of each page of pmem and MMIO. Addresses
+// are taken as physical ones, since vaddr_*() access paddr directly. For
+// each interval of HEATMAP_INTERVAL instructions, a line
+//   interval page reads writes fetches
+// is written for each page touched in the interval. The number of these
+// pages is the working set of the interval.
+
+#define NR_PAGE (CONFIG_MSIZE / PAGE_SIZE)
+#define NR_MMIO_PAGE 256 // must be a power of 2
+
+static const char *type_name = "rwx";
+
+typedef struct {
+  paddr_t addr;
+  uint32_t stamp; // the last interval touching the page plus 1, 0 if never touched
+  uint32_t interval_count[3];
+  uint64_t count[3];
+} Page;
+
+static Page *pages = NULL; // pmem pages, followed by a hash table of MMIO pages
+static Page **touched = NULL;
+static uint32_t nr_touched = 0, max_ws = 0;
+static uint64_t sum_ws = 0;
+static uint32_t cur = 0; // the current interval
+static uint64_t next_interval = CONFIG_HEATMAP_INTERVAL;
+static FILE *heatmap_fp = NULL;
+bool g_heatmap_on = false;
+
+extern uint64_t g_nr_guest_inst;
+
+static Page* mmio_page(paddr_t addr) {
+  Page *mmio = pages + NR_PAGE;
+  uint32_t i = (addr >> PAGE_SHIFT) & (NR_MMIO_PAGE - 1), n;
+  for (n = 0; n < NR_MMIO_PAGE; n ++, i = (i + 1) & (NR_MMIO_PAGE - 1)) {
+    if (mmio[i].stamp == 0) { // a free slot
+      mmio[i].addr = addr;
+      return &mmio[i];
+    }
+    if (mmio[i].addr == addr) return &mmio[i];
+  }
+  return NULL; // too many MMIO pages, ignored
+}
+
+static void end_interval() {
+  uint32_t i;
+  for (i = 0; i < nr_touched; i ++) {
+    Page *p = touched[i];
+    fprintf(heatmap_fp, "%" PRIu32 " " FMT_PADDR " %" PRIu32 " %" PRIu32 " %" PRIu32 "\n",
+        cur, p->addr, p->interval_count[0], p->interval_count[1], p->interval_count[2]);
+    memset(p->interval_count, 0, sizeof(p->interval_count));
+  }
+  if (nr_touched > max_ws) max_ws = nr_touched;
+  sum_ws += nr_touched;
+  nr_touched = 0;
+  cur ++;
+}
+
+void heatmap_access(char type, paddr_t addr) {
+  while (g_nr_guest_inst >= next_interval) {
+    end_interval();
+    next_interval += CONFIG_HEATMAP_INTERVAL;
+  }
+  paddr_t page = addr & ~(paddr_t)PAGE_MASK;
+  Page *p = (in_pmem(addr) ? &pages[(page - CONFIG_MBASE) >> PAGE_SHIFT] : mmio_page(page));
+  if (p == NULL) return;
+  if (p->stamp != cur + 1) {
+    p->stamp = cur + 1;
+    touched[nr_touched ++] = p;
+  }
+  int t = strchr(type_name, type) - type_name;
+  p->interval_count[t] ++;
+  p->count[t] ++;
+}
+
+// start the intervals from now when switching to the detailed mode
+void heatmap_restart() {
+  if (heatmap_fp == NULL) return;
+  next_interval = g_nr_guest_inst + CONFIG_HEATMAP_INTERVAL;
+  g_heatmap_on = true;
+}
+
+static uint64_t total_count(const Page *p) {
+  return p->count[0] + p->count[1] + p->count[2];
+}
+
+static int cmp_count(const void *a, const void *b) {
+  uint64_t x = total_count(*(Page **)a), y = total_count(*(Page **)b);
+  return (x < y) - (x > y);
+}
+
+void heatmap_report() {
+  if (heatmap_fp == NULL) return;
+  if (nr_touched > 0) end_interval();
+  fclose(heatmap_fp);
+  heatmap_fp = NULL;
+  g_heatmap_on = false;
+
+  Page **hot = malloc(sizeof(Page *) * (NR_PAGE + NR_MMIO_PAGE));
+  assert(hot);
+  uint32_t i, n = 0, nr_pmem = 0;
+  for (i = 0; i < NR_PAGE + NR_MMIO_PAGE; i ++) {
+    if (pages[i].stamp == 0) continue;
+    hot[n ++] = &pages[i];
+    if (i < NR_PAGE) nr_pmem ++;
+  }
+  Log("Footprint = %" PRIu32 " pmem pages (%" PRIu64 " KB) and %" PRIu32 " MMIO pages",
+      nr_pmem, (uint64_t)nr_pmem * PAGE_SIZE / 1024, n - nr_pmem);
+  Log("Working set per %d instructions: max = %" PRIu32 " pages, average = %.1f pages",
+      CONFIG_HEATMAP_INTERVAL, max_ws, (cur > 0 ? (double)sum_ws / cur : 0));
+
+  qsort(hot, n, sizeof(Page *), cmp_count);
+  Log("Hottest pages:");
+  Log("%-10s %12s %12s %12s  %s", "page", "reads", "writes", "fetches", "section/symbol");
+  for (i = 0; i < n && i < CONFIG_HEATMAP_TOP_N; i ++) {
+    Page *p = hot[i];
+    const char *sec = elf_sec_name(p->addr), *sym = elf_range_name(p->addr, p->addr + PAGE_SIZE);
+    Log(FMT_PADDR " %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "  %s%s%s", p->addr,
+        p->count[0], p->count[1], p->count[2], (sec ? sec : (in_pmem(p->addr) ? "-" : "mmio")),
+        (sym ? "/" : ""), (sym ? sym : ""));
+  }
+  free(hot);
+}
+
+void init_heatmap(const char *heatmap_file) {
+  if (heatmap_file == NULL) return;
+  heatmap_fp = fopen(heatmap_file, "w");
+  Assert(heatmap_fp, "Can not open '%s'", heatmap_file);
+  setvbuf(heatmap_fp, NULL, _IOFBF, 1 << 20);
+  fprintf(heatmap_fp, "# interval page reads writes fetches\n");
+  pages = calloc(NR_PAGE + NR_MMIO_PAGE, sizeof(Page));
+  touched = malloc(sizeof(Page *) * (NR_PAGE + NR_MMIO_PAGE));
+  assert(pages && touched);
+  uint32_t i;
+  for (i = 0; i < NR_PAGE; i ++) pages[i].addr = CONFIG_MBASE + ((paddr_t)i << PAGE_SHIFT);
+  g_heatmap_on = true;
+  Log("Memory heatmap of every %d instructions is written to %s", CONFIG_HEATMAP_INTERVAL, heatmap_file);
+}
+#endif
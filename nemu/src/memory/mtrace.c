@@ -0,0 +1,115 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <isa.h>
+
+#ifdef CONFIG_MTRACE
+#define NR_RANGE 8
+
+static const char *type_name = "rwx";
+static bool type_on[3] = { true, true, true }; // indexed by the position in type_name
+typedef struct {
+  paddr_t lo, hi;
+} Range;
+
+static Range ranges[NR_RANGE];
+static int nr_range = 0;
+static uint64_t sample = 1; // record 1 in `sample' accesses
+static uint64_t countdown = 1;
+
+static bool in_ranges(paddr_t addr) {
+  if (nr_range == 0) return true;
+  int i;
+  for (i = 0; i < nr_range; i ++) {
+    if (addr >= ranges[i].lo && addr < ranges[i].hi) return true;
+  }
+  return false;
+}
+
+void mtrace_access(char type, paddr_t addr, int len, word_t data) {
+  if (!trace_on(TRACE_MEM, cpu.pc)) return;
+  if (!type_on[strchr(type_name, type) - type_name] || !in_ranges(addr)) return;
+  if (-- countdown > 0) return;
+  countdown = sample;
+
+#ifdef CONFIG_BTRACE
+  if (btrace_enabled()) {
+    btrace_mem(type, addr, len, data);
+    return;
+  }
+#endif
+  log_write("[mtrace] pc = " FMT_WORD ": %c " FMT_PADDR ", len = %d, data = " FMT_WORD "\n",
+      cpu.pc, type, addr, len, data);
+}
+
+// OPTS is a comma-separated list of
+//   r, w, x or their combinations: the types of access to trace
+//   LO-HI: only trace addresses in [LO, HI), can be given several times
+//   1/N: only record one in every N accesses
+// All types of access are traced if none is given.
+bool mtrace_set(char *opts) {
+  bool new_type_on[3] = {};
+  bool has_type = false;
+  Range new_ranges[NR_RANGE];
+  int new_nr_range = 0;
+  uint64_t new_sample = 1;
+  char *s, *saveptr;
+  for (s = strtok_r(opts, ",", &saveptr); s != NULL; s = strtok_r(NULL, ",", &saveptr)) {
+    char *end;
+    if (strspn(s, type_name) == strlen(s)) {
+      for (; *s != '\0'; s ++) new_type_on[strchr(type_name, *s) - type_name] = true;
+      has_type = true;
+    } else if (strncmp(s, "1/", 2) == 0) {
+      new_sample = strtoull(s + 2, &end, 0);
+      if (*end != '\0' || new_sample == 0) goto bad;
+    } else {
+      if (new_nr_range == NR_RANGE) {
+        printf(ANSI_FMT("At most %d address ranges are supported.\n", ANSI_FG_RED), NR_RANGE);
+        return false;
+      }
+      char *lo = s;
+      new_ranges[new_nr_range].lo = strtoull(lo, &end, 0);
+      if (end == lo || *end != '-') goto bad;
+      new_ranges[new_nr_range].hi = strtoull(end + 1, &end, 0);
+      if (*end != '\0') goto bad;
+      new_nr_range ++;
+    }
+  }
+  int i;
+  for (i = 0; i < 3; i ++) type_on[i] = !has_type || new_type_on[i];
+  memcpy(ranges, new_ranges, sizeof(Range) * new_nr_range);
+  nr_range = new_nr_range;
+  sample = countdown = new_sample;
+  return true;
+
+bad:
+  printf(ANSI_FMT("Expect a list of r/w/x, LO-HI or 1/N, but got '%s'.\n", ANSI_FG_RED), s);
+  return false;
+}
+
+void mtrace_display() {
+  int i;
+  printf("Memory accesses:");
+  for (i = 0; i < 3; i ++) {
+    if (type_on[i]) printf(" %c", type_name[i]);
+  }
+  for (i = 0; i < nr_range; i ++) {
+    printf(" [" FMT_PADDR ", " FMT_PADDR ")", ranges[i].lo, ranges[i].hi);
+  }
+  if (sample > 1) printf(" 1/%" PRIu64, sample);
+  printf("\n");
+}
+#endif
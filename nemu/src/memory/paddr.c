@@ -15,7 +15,9 @@
 
 #include <memory/host.h>
 #include <memory/paddr.h>
+#include <memory/vaddr.h>
 #include <device/mmio.h>
+#include <cpu/difftest.h>
 #include <isa.h>
 
 #if   defined(CONFIG_PMEM_MALLOC)
@@ -27,12 +29,46 @@ static uint8_t pmem[CONFIG_MSIZE] PG_ALIGN = {};
 uint8_t* guest_to_host(paddr_t paddr) { return pmem + paddr - CONFIG_MBASE; }
 paddr_t host_to_guest(uint8_t *haddr) { return haddr - pmem + CONFIG_MBASE; }
 
+#ifdef CONFIG_PMEM_DIRTY
+#define NR_PAGE (CONFIG_MSIZE / PAGE_SIZE)
+
+static bool page_dirty[NR_PAGE] = {};
+static uint32_t dirty_list[NR_PAGE];
+static int nr_dirty = 0;
+
+static inline void mark_dirty(paddr_t addr) {
+  uint32_t idx = (addr - CONFIG_MBASE) >> PAGE_SHIFT;
+  if (!page_dirty[idx]) {
+    page_dirty[idx] = true;
+    dirty_list[nr_dirty ++] = idx;
+  }
+}
+
+// get the base address of pages written since the last call
+int pmem_dirty_pages(paddr_t *pages, int max) {
+  int i, n = 0;
+  for (i = 0; i < nr_dirty; i ++) {
+    if (n < max) pages[n ++] = CONFIG_MBASE + ((paddr_t)dirty_list[i] << PAGE_SHIFT);
+    page_dirty[dirty_list[i]] = false;
+  }
+  nr_dirty = 0;
+  return n;
+}
+#endif
+
 static word_t pmem_read(paddr_t addr, int len) {
   word_t ret = host_read(guest_to_host(addr), len);
   return ret;
 }
 
 static void pmem_write(paddr_t addr, int len, word_t data) {
+  IFDEF(CONFIG_DIFFTEST_SYNC_BATCH, difftest_log_store(addr, len));
+  IFDEF(CONFIG_CTRACE, ctrace_store(addr, len, data));
+#ifdef CONFIG_PMEM_DIRTY
+  mark_dirty(addr);
+  // the write may cross the page boundary
+  if (unlikely(((addr + len - 1) ^ addr) & ~PAGE_MASK)) mark_dirty(addr + len - 1);
+#endif
   host_write(guest_to_host(addr), len, data);
 }
 
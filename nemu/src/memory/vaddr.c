@@ -15,15 +15,46 @@
 
 #include <isa.h>
 #include <memory/paddr.h>
+#include <cpu/cpu.h>
+#include <cpu/hpm.h>
+#include <phase.h>
 
+// No instrumentation works when fast forwarding. The heatmap is turned
+// off and the trace window is closed then, so only the binary trace,
+// which is not built by default, has to check it.
+static inline void trace_mem(char type, vaddr_t addr, int len, word_t data) {
+  IFDEF(CONFIG_HEATMAP, heatmap(type, addr));
+#ifdef CONFIG_MTRACE
+  mtrace(type, addr, len, data);
+#elif defined(CONFIG_BTRACE)
+  // without mtrace, all loads and stores are recorded
+  if (type != 'x' && !fast_forwarding()) btrace_mem(type, addr, len, data);
+#endif
+}
+
+// the time of paddr_read() and paddr_write() is counted here,
+// so that instruction fetches are separated from loads and stores
 word_t vaddr_ifetch(vaddr_t addr, int len) {
-  return paddr_read(addr, len);
+  PHASE_ENTER(PHASE_FETCH);
+  word_t ret = paddr_read(addr, len);
+  trace_mem('x', addr, len, ret);
+  PHASE_EXIT();
+  return ret;
 }
 
 word_t vaddr_read(vaddr_t addr, int len) {
-  return paddr_read(addr, len);
+  PHASE_ENTER(PHASE_MEM);
+  hpm_count(HPM_LOAD);
+  word_t ret = paddr_read(addr, len);
+  trace_mem('r', addr, len, ret);
+  PHASE_EXIT();
+  return ret;
 }
 
 void vaddr_write(vaddr_t addr, int len, word_t data) {
+  PHASE_ENTER(PHASE_MEM);
+  hpm_count(HPM_STORE);
+  trace_mem('w', addr, len, data);
   paddr_write(addr, len, data);
+  PHASE_EXIT();
 }
@@ -0,0 +1,146 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <common.h>
+
+#ifndef CONFIG_TARGET_AM
+#include <elf.h>
+
+typedef MUXDEF(CONFIG_ISA64, Elf64_Ehdr, Elf32_Ehdr) Elf_Ehdr;
+typedef MUXDEF(CONFIG_ISA64, Elf64_Shdr, Elf32_Shdr) Elf_Shdr;
+typedef MUXDEF(CONFIG_ISA64, Elf64_Sym , Elf32_Sym ) Elf_Sym;
+#define ELF_ST_TYPE MUXDEF(CONFIG_ISA64, ELF64_ST_TYPE, ELF32_ST_TYPE)
+
+typedef struct {
+  vaddr_t addr;
+  word_t size;
+  const char *name;
+} Symbol;
+
+// function symbols, data symbols and allocated sections, sorted by address
+static Symbol *syms = NULL, *objs = NULL, *secs = NULL;
+static int nr_sym = 0, nr_obj = 0, nr_sec = 0;
+
+static int cmp_sym(const void *a, const void *b) {
+  vaddr_t x = ((Symbol *)a)->addr, y = ((Symbol *)b)->addr;
+  return (x > y) - (x < y);
+}
+
+void init_elf(const char *elf_file) {
+  if (elf_file == NULL) return;
+
+  FILE *fp = fopen(elf_file, "rb");
+  Assert(fp, "Can not open '%s'", elf_file);
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  uint8_t *elf = malloc(size); // kept for the names of symbols
+  assert(elf);
+  int ret = fread(elf, size, 1, fp);
+  assert(ret == 1);
+  fclose(fp);
+
+  Elf_Ehdr *eh = (void *)elf;
+  Assert(memcmp(eh->e_ident, ELFMAG, SELFMAG) == 0 &&
+      eh->e_ident[EI_CLASS] == MUXDEF(CONFIG_ISA64, ELFCLASS64, ELFCLASS32),
+      "'%s' is not an ELF file of " str(__GUEST_ISA__), elf_file);
+
+  Elf_Shdr *sh = (void *)(elf + eh->e_shoff);
+  const char *shstrtab = (void *)(elf + sh[eh->e_shstrndx].sh_offset);
+  int i, j;
+  secs = malloc(sizeof(Symbol) * eh->e_shnum);
+  assert(secs);
+  for (i = 0; i < eh->e_shnum; i ++) {
+    if (!(sh[i].sh_flags & SHF_ALLOC) || sh[i].sh_size == 0) continue;
+    secs[nr_sec ++] = (Symbol) { .addr = sh[i].sh_addr,
+      .size = sh[i].sh_size, .name = shstrtab + sh[i].sh_name };
+  }
+  for (i = 0; i < eh->e_shnum; i ++) {
+    if (sh[i].sh_type != SHT_SYMTAB) continue;
+    Elf_Sym *sym = (void *)(elf + sh[i].sh_offset);
+    const char *strtab = (void *)(elf + sh[sh[i].sh_link].sh_offset);
+    int n = sh[i].sh_size / sizeof(Elf_Sym);
+    syms = malloc(sizeof(Symbol) * n);
+    objs = malloc(sizeof(Symbol) * n);
+    assert(syms && objs);
+    for (j = 0; j < n; j ++) {
+      if (sym[j].st_size == 0) continue;
+      Symbol s = { .addr = sym[j].st_value, .size = sym[j].st_size, .name = strtab + sym[j].st_name };
+      switch (ELF_ST_TYPE(sym[j].st_info)) {
+        case STT_FUNC: syms[nr_sym ++] = s; break;
+        case STT_OBJECT: objs[nr_obj ++] = s; break;
+      }
+    }
+    break;
+  }
+  qsort(syms, nr_sym, sizeof(Symbol), cmp_sym);
+  qsort(objs, nr_obj, sizeof(Symbol), cmp_sym);
+  qsort(secs, nr_sec, sizeof(Symbol), cmp_sym);
+
+  Log("Read %d function symbols, %d data symbols and %d sections from %s", nr_sym, nr_obj, nr_sec, elf_file);
+}
+
+// return the index of the last entry in `s' starting at or before `addr', or -1
+static int find(Symbol *s, int n, vaddr_t addr) {
+  int lo = 0, hi = n - 1, ret = -1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (s[mid].addr <= addr) { ret = mid; lo = mid + 1; }
+    else hi = mid - 1;
+  }
+  return ret;
+}
+
+// return the name of the function containing `addr', or NULL
+const char* elf_sym_name(vaddr_t addr, vaddr_t *start) {
+  int i = find(syms, nr_sym, addr);
+  if (i < 0 || addr - syms[i].addr >= syms[i].size) return NULL;
+  if (start != NULL) *start = syms[i].addr;
+  return syms[i].name;
+}
+
+// return the name of the section containing `addr', or NULL
+const char* elf_sec_name(vaddr_t addr) {
+  int i = find(secs, nr_sec, addr);
+  if (i < 0 || addr - secs[i].addr >= secs[i].size) return NULL;
+  return secs[i].name;
+}
+
+// return the name of a function or data symbol in [lo, hi), or NULL
+const char* elf_range_name(vaddr_t lo, vaddr_t hi) {
+  Symbol *tab[] = { syms, objs };
+  int n[] = { nr_sym, nr_obj };
+  int k;
+  for (k = 0; k < 2; k ++) {
+    int i = find(tab[k], n[k], lo);
+    if (i >= 0 && lo - tab[k][i].addr < tab[k][i].size) return tab[k][i].name;
+    if (i + 1 < n[k] && tab[k][i + 1].addr < hi) return tab[k][i + 1].name;
+  }
+  return NULL;
+}
+
+bool elf_sym_lookup(const char *name, vaddr_t *start, word_t *size) {
+  int i;
+  for (i = 0; i < nr_sym; i ++) {
+    if (strcmp(syms[i].name, name) == 0) {
+      *start = syms[i].addr;
+      *size = syms[i].size;
+      return true;
+    }
+  }
+  return false;
+}
+#endif
@@ -20,6 +20,18 @@ void init_rand();
 void init_log(const char *log_file);
 void init_mem();
 void init_difftest(char *ref_so_file, long img_size, int port);
+void init_ctrace(const char *ctrace_file, long img_size);
+void init_btrace(const char *btrace_file);
+void init_elf(const char *elf_file);
+void init_ftrace(char *folded);
+void init_profile(char *file, const char *period);
+void init_bbv(const char *bbv_file, const char *interval);
+void init_heatmap(const char *heatmap_file);
+void init_stats_json(const char *stats_file);
+void init_timeline(char *file);
+void init_roi(const char *mode);
+void init_ffwd(const char *arg);
+void init_trace(char *kinds, const char *window, const char *pc, char *mtrace_opts);
 void init_device();
 void init_sdb();
 void init_disasm(const char *triple);
@@ -44,6 +56,23 @@ void sdb_set_batch_mode();
 static char *log_file = NULL;
 static char *diff_so_file = NULL;
 static char *img_file = NULL;
+static char *ctrace_file = NULL;
+static char *btrace_file = NULL;
+static char *elf_file = NULL;
+static char *trace_kinds = NULL;
+static char *trace_window = NULL;
+static char *trace_pc = NULL;
+static char *mtrace_opts = NULL;
+static char *folded_file = NULL;
+static char *profile_file = NULL;
+static char *profile_period = NULL;
+static char *bbv_file = NULL;
+static char *bbv_interval = NULL;
+static char *heatmap_file = NULL;
+static char *stats_file = NULL;
+static char *timeline_file = NULL;
+static char *roi_mode = NULL;
+static char *ffwd_arg = NULL;
 static int difftest_port = 1234;
 
 static long load_img() {
@@ -74,16 +103,50 @@ static int parse_args(int argc, char *argv[]) {
     {"log"      , required_argument, NULL, 'l'},
     {"diff"     , required_argument, NULL, 'd'},
     {"port"     , required_argument, NULL, 'p'},
+    {"ctrace"   , required_argument, NULL, 'c'},
+    {"btrace"   , required_argument, NULL, 't'},
+    {"elf"      , required_argument, NULL, 'e'},
+    {"trace"    , required_argument, NULL, 'T'},
+    {"trace-window", required_argument, NULL, 'W'},
+    {"trace-pc" , required_argument, NULL, 'P'},
+    {"mtrace"   , required_argument, NULL, 'M'},
+    {"ftrace"   , required_argument, NULL, 'F'},
+    {"profile"  , required_argument, NULL, 'R'},
+    {"profile-period", required_argument, NULL, 'N'},
+    {"bbv"      , required_argument, NULL, 'B'},
+    {"bbv-interval", required_argument, NULL, 'I'},
+    {"heatmap"  , required_argument, NULL, 'H'},
+    {"stats-json", required_argument, NULL, 'S'},
+    {"timeline" , required_argument, NULL, 'L'},
+    {"roi"      , optional_argument, NULL, 'O'},
+    {"fast-forward", required_argument, NULL, 'f'},
     {"help"     , no_argument      , NULL, 'h'},
     {0          , 0                , NULL,  0 },
   };
   int o;
-  while ( (o = getopt_long(argc, argv, "-bhl:d:p:", table, NULL)) != -1) {
+  while ( (o = getopt_long(argc, argv, "-bhl:d:p:c:t:e:", table, NULL)) != -1) {
     switch (o) {
       case 'b': sdb_set_batch_mode(); break;
       case 'p': sscanf(optarg, "%d", &difftest_port); break;
       case 'l': log_file = optarg; break;
       case 'd': diff_so_file = optarg; break;
+      case 'c': ctrace_file = optarg; break;
+      case 't': btrace_file = optarg; break;
+      case 'e': elf_file = optarg; break;
+      case 'T': trace_kinds = optarg; break;
+      case 'W': trace_window = optarg; break;
+      case 'P': trace_pc = optarg; break;
+      case 'M': mtrace_opts = optarg; break;
+      case 'F': folded_file = optarg; break;
+      case 'R': profile_file = optarg; break;
+      case 'N': profile_period = optarg; break;
+      case 'B': bbv_file = optarg; break;
+      case 'I': bbv_interval = optarg; break;
+      case 'H': heatmap_file = optarg; break;
+      case 'S': stats_file = optarg; break;
+      case 'L': timeline_file = optarg; break;
+      case 'O': roi_mode = (optarg != NULL ? optarg : "scope"); break;
+      case 'f': ffwd_arg = optarg; break;
       case 1: img_file = optarg; return 0;
       default:
         printf("Usage: %s [OPTION...] IMAGE [args]\n\n", argv[0]);
@@ -91,6 +154,25 @@ static int parse_args(int argc, char *argv[]) {
         printf("\t-l,--log=FILE           output log to FILE\n");
         printf("\t-d,--diff=REF_SO        run DiffTest with reference REF_SO\n");
         printf("\t-p,--port=PORT          run DiffTest with port PORT\n");
+        printf("\t-c,--ctrace=FILE        record commit trace to FILE\n");
+        printf("\t-t,--btrace=FILE        record binary trace to FILE\n");
+        printf("\t-e,--elf=FILE           read symbols from the ELF FILE of the image\n");
+        printf("\t--trace=KINDS           trace KINDS (inst,dev,mem,func or all) instead of the default\n");
+        printf("\t--trace-window=FROM-TO  only trace the FROM-th to the TO-th instruction\n");
+        printf("\t--trace-pc=LO-HI|FUNC   only trace when LO <= pc < HI, or in function FUNC\n");
+        printf("\t--mtrace=OPTS           trace memory accesses with filters OPTS (r,w,x,LO-HI,1/N)\n");
+        printf("\t--ftrace=FILE           write the folded call stacks to FILE at exit\n");
+        printf("\t--profile=FILE          sample the pc and write the folded stacks to FILE at exit\n");
+        printf("\t--profile-period=N|Nhz  sample every N instructions, or N times per second of CPU time\n");
+        printf("\t--bbv=FILE              write basic block vectors for SimPoint to FILE\n");
+        printf("\t--bbv-interval=N        write a basic block vector every N instructions\n");
+        printf("\t--heatmap=FILE          write the accesses to each memory page to FILE\n");
+        printf("\t--stats-json=FILE       write the statistics to FILE as JSON lines\n");
+        printf("\t--timeline=FILE         write the timeline of events to FILE in Chrome trace format\n");
+        printf("\t--roi[=fast]            only trace and profile in regions of interest marked by the guest,\n");
+        printf("\t                        and skip other instrumentation outside regions with fast\n");
+        printf("\t--fast-forward=N[,M]    run N instructions with no instrumentation before the detailed mode,\n");
+        printf("\t                        and quit after M instructions in the detailed mode\n");
         printf("\n");
         exit(0);
     }
@@ -110,6 +192,9 @@ void init_monitor(int argc, char *argv[]) {
   /* Open the log file. */
   init_log(log_file);
 
+  /* Start the timeline of events. */
+  IFDEF(CONFIG_TIMELINE, init_timeline(timeline_file));
+
   /* Initialize memory. */
   init_mem();
 
@@ -125,6 +210,39 @@ void init_monitor(int argc, char *argv[]) {
   /* Initialize differential testing. */
   init_difftest(diff_so_file, img_size, difftest_port);
 
+  /* Initialize commit trace for offline differential testing. */
+  IFDEF(CONFIG_CTRACE, init_ctrace(ctrace_file, img_size));
+
+  /* Initialize binary trace. */
+  IFDEF(CONFIG_BTRACE, init_btrace(btrace_file));
+
+  /* Read symbols of the image. */
+  init_elf(elf_file);
+
+  /* Initialize the function call profiler. */
+  IFDEF(CONFIG_FTRACE, init_ftrace(folded_file));
+
+  /* Initialize the sampling profiler. */
+  IFDEF(CONFIG_PROFILE, init_profile(profile_file, profile_period));
+
+  /* Initialize basic block vectors. */
+  IFDEF(CONFIG_BBV, init_bbv(bbv_file, bbv_interval));
+
+  /* Initialize the memory heatmap. */
+  IFDEF(CONFIG_HEATMAP, init_heatmap(heatmap_file));
+
+  /* Open the file of statistics. */
+  IFDEF(CONFIG_STATS_JSON, init_stats_json(stats_file));
+
+  /* Scope the instrumentation to regions of interest. */
+  IFDEF(CONFIG_ROI, init_roi(roi_mode));
+
+  /* Skip the instrumentation of the first instructions. */
+  IFDEF(CONFIG_FAST_FORWARD, init_ffwd(ffwd_arg));
+
+  /* Set up what to trace. */
+  IFDEF(CONFIG_TRACE, init_trace(trace_kinds, trace_window, trace_pc, mtrace_opts));
+
   /* Initialize the simple debugger. */
   init_sdb();
 
@@ -27,6 +27,7 @@ void init_wp_pool();
 void new_wp(char*);
 void free_wp(int);
 void print_wp_state();
+void map_stat_display();
 
 /* We use the `readline' library to provide more flexibility to read from stdin. */
 static char* rl_gets() {
@@ -80,8 +81,14 @@ static int cmd_info(char *args) {
     isa_reg_display();
   } else if(strcmp(args, "w") == 0) {
     print_wp_state();
+  } else if(strcmp(args, "trace") == 0) {
+    MUXDEF(CONFIG_IRINGBUF, iringbuf_dump(),
+      printf(ANSI_FMT("Instruction ring buffer is not enabled.\n", ANSI_FG_RED)));
+  } else if(strcmp(args, "dev") == 0) {
+    MUXDEF(CONFIG_DEVICE_STAT, map_stat_display(),
+      printf(ANSI_FMT("Device statistics are not enabled.\n", ANSI_FG_RED)));
   } else {
-    printf(ANSI_FMT("Wrong argument(expect \"r\" or \"w\").\n", ANSI_FG_RED));
+    printf(ANSI_FMT("Wrong argument(expect \"r\", \"w\", \"trace\" or \"dev\").\n", ANSI_FG_RED));
   }
   return 0;
 }
@@ -135,6 +142,29 @@ static int cmd_d(char* args) {
   return 0;
 }
 
+#ifdef CONFIG_TRACE
+static int cmd_trace(char *args) {
+  char *sub = strtok(args, " ");
+  char *arg = strtok(NULL, " ");
+  if (sub == NULL) {
+    trace_display();
+  } else if ((strcmp(sub, "on") == 0 || strcmp(sub, "off") == 0) && arg != NULL) {
+    trace_set_kinds(arg, strcmp(sub, "on") == 0);
+  } else if (strcmp(sub, "window") == 0 && arg != NULL) {
+    trace_set_window(arg);
+  } else if (strcmp(sub, "pc") == 0 && arg != NULL) {
+    trace_set_pc(arg);
+#ifdef CONFIG_MTRACE
+  } else if (strcmp(sub, "mem") == 0 && arg != NULL) {
+    mtrace_set(arg);
+#endif
+  } else {
+    printf(ANSI_FMT("Expect \"on KINDS\", \"off KINDS\", \"window FROM-TO\", \"pc LO-HI|FUNC\" or \"mem OPTS\".\n", ANSI_FG_RED));
+  }
+  return 0;
+}
+#endif
+
 static struct {
   const char *name;
   const char *description;
@@ -144,11 +174,14 @@ static struct {
   { "c", "Continue the execution of the program", cmd_c },
   { "q", "Exit NEMU", cmd_q },
   { "si", "(si [N]) Execute N(1 by default) instructions in single step and then pause it", cmd_si},
-  { "info", "(info r/w) Print the status of registers/watchpoints", cmd_info },
+  { "info", "(info r/w/trace/dev) Print the status of registers/watchpoints, recently executed instructions, or device accesses", cmd_info },
   { "x", "(x N EXPR) Print N bytes since address EXPR as an expression", cmd_x },
   { "p", "(p EXPR) Print the result of an expression", cmd_p },
   { "w" ,"(w EXPR) Set a new watchpoint, when the value of w changed, pause the program", cmd_w },
   { "d", "(d N) Delete the watchpoint with number N", cmd_d },
+#ifdef CONFIG_TRACE
+  { "trace", "(trace [on/off KINDS | window FROM-TO | pc LO-HI/FUNC | mem OPTS]) Show or change what to trace", cmd_trace },
+#endif
 };
 
 #define NR_CMD ARRLEN(cmd_table)
@@ -63,6 +63,10 @@ void free_wp(int NO) {
   if (i == wp_num) printf(ANSI_FMT("Can't find watchpoint [%d]\n", ANSI_FG_RED), NO);
 }
 
+bool wp_in_use() {
+  return wp_num > 0;
+}
+
 bool scan_wp() {
   bool changed = false;
   for (int i = 0; i < wp_num; ++i) {
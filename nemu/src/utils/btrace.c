@@ -0,0 +1,173 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <common.h>
+#include <btrace-def.h>
+
+#ifdef CONFIG_BTRACE
+#include <pthread.h>
+#include <zlib.h>
+
+// Records are written to one of the buffers, and the buffers are
+// compressed and written to the file by another thread. A block is
+// only ended between instructions, so the space left for the memory
+// accesses of one instruction should be large enough.
+#define NR_BUF 4
+#define BUF_SLACK 4096
+
+typedef struct {
+  uint8_t data[BTRACE_BLOCK_SIZE];
+  uint32_t size;
+  uint64_t first_inst;
+  uint64_t nr_inst;
+  bool full;
+} BTraceBuf;
+
+static FILE *btrace_fp = NULL;
+static BTraceBuf *bufs = NULL;
+static BTraceBuf *cur = NULL;
+static uint8_t *p = NULL;
+static int cur_idx = 0;
+static uint64_t nr_inst = 0;
+static word_t next_pc = 0;
+static word_t last_addr = 0;
+
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static bool stop = false;
+
+static void* writer_main(void *arg) {
+  uLong bound = compressBound(BTRACE_BLOCK_SIZE);
+  uint8_t *out = malloc(bound);
+  assert(out);
+  int i = 0;
+  while (true) {
+    BTraceBuf *b = &bufs[i];
+    pthread_mutex_lock(&lock);
+    while (!b->full && !stop) pthread_cond_wait(&cond, &lock);
+    pthread_mutex_unlock(&lock);
+    // buffers are filled in order, so all of them are written
+    // if this one is not full after stopping
+    if (!b->full) break;
+
+    uLongf size = bound;
+    int ret = compress2(out, &size, b->data, b->size, Z_BEST_SPEED);
+    assert(ret == Z_OK);
+    BTraceBlock h = { .raw_size = b->size, .size = size,
+      .first_inst = b->first_inst, .nr_inst = b->nr_inst };
+    fwrite(&h, sizeof(h), 1, btrace_fp);
+    fwrite(out, size, 1, btrace_fp);
+
+    pthread_mutex_lock(&lock);
+    b->full = false;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+    i = (i + 1) % NR_BUF;
+  }
+  free(out);
+  return NULL;
+}
+
+static void new_block() {
+  p = cur->data;
+  cur->first_inst = nr_inst;
+  cur->nr_inst = 0;
+  next_pc = 0;
+  last_addr = 0;
+}
+
+static void submit() {
+  cur->size = p - cur->data;
+  pthread_mutex_lock(&lock);
+  cur->full = true;
+  pthread_cond_broadcast(&cond);
+  cur_idx = (cur_idx + 1) % NR_BUF;
+  cur = &bufs[cur_idx];
+  while (cur->full) pthread_cond_wait(&cond, &lock);
+  pthread_mutex_unlock(&lock);
+  new_block();
+}
+
+void btrace_close() {
+  if (btrace_fp == NULL) return;
+  if (p != cur->data) submit();
+  pthread_mutex_lock(&lock);
+  stop = true;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+  pthread_join(writer, NULL);
+  fclose(btrace_fp);
+  btrace_fp = NULL;
+}
+
+void init_btrace(const char *btrace_file) {
+  if (btrace_file == NULL) return;
+
+  btrace_fp = fopen(btrace_file, "wb");
+  Assert(btrace_fp, "Can not open '%s'", btrace_file);
+  BTraceHeader h = { .magic = BTRACE_MAGIC, .version = BTRACE_VERSION, .word_size = sizeof(word_t) };
+  fwrite(&h, sizeof(h), 1, btrace_fp);
+
+  bufs = calloc(NR_BUF, sizeof(BTraceBuf));
+  assert(bufs);
+  cur = &bufs[0];
+  new_block();
+  int ret = pthread_create(&writer, NULL, writer_main, NULL);
+  Assert(ret == 0, "Can not create the trace writer thread");
+  atexit(btrace_close);
+
+  Log("Binary trace is written to %s", btrace_file);
+}
+
+bool btrace_enabled() {
+  return btrace_fp != NULL;
+}
+
+void btrace_inst(vaddr_t pc, uint8_t *inst, int ilen) {
+  if (btrace_fp == NULL) return;
+  *p ++ = BTRACE_INST;
+  p = btrace_put_sleb(p, (int64_t)pc - (int64_t)next_pc);
+  *p ++ = ilen;
+  memcpy(p, inst, ilen);
+  p += ilen;
+  next_pc = pc + ilen;
+  nr_inst ++;
+  cur->nr_inst ++;
+  if (p - cur->data > BTRACE_BLOCK_SIZE - BUF_SLACK) submit();
+}
+
+void btrace_mem(char type, paddr_t addr, int len, word_t data) {
+  if (btrace_fp == NULL) return;
+  *p ++ = (type == 'w' ? BTRACE_MEM_W : type == 'x' ? BTRACE_MEM_X : BTRACE_MEM_R);
+  p = btrace_put_sleb(p, (int64_t)addr - (int64_t)last_addr);
+  *p ++ = len;
+  p = btrace_put_uleb(p, data);
+  last_addr = addr;
+}
+
+void btrace_dev(bool is_write, paddr_t addr, int len, word_t data, const char *name) {
+  if (btrace_fp == NULL) return;
+  *p ++ = (is_write ? BTRACE_DEV_W : BTRACE_DEV_R);
+  p = btrace_put_uleb(p, addr);
+  *p ++ = len;
+  p = btrace_put_uleb(p, data);
+  int n = strnlen(name, BTRACE_DEV_NAME_MAX - 1);
+  memcpy(p, name, n);
+  p[n] = '\0';
+  p += n + 1;
+}
+#endif
@@ -22,6 +22,7 @@
 #include "llvm/MC/MCContext.h"
 #include "llvm/MC/MCDisassembler/MCDisassembler.h"
 #include "llvm/MC/MCInstPrinter.h"
+#include "llvm/MC/MCInstrInfo.h"
 #if LLVM_VERSION_MAJOR >= 14
 #include "llvm/MC/TargetRegistry.h"
 #else
@@ -42,6 +43,28 @@ using namespace llvm;
 static llvm::MCDisassembler *gDisassembler = nullptr;
 static llvm::MCSubtargetInfo *gSTI = nullptr;
 static llvm::MCInstPrinter *gIP = nullptr;
+static llvm::MCInstrInfo *gMII = nullptr;
+
+// A direct-mapped cache of disassembled text. Most instructions are
+// indexed by the instruction bytes only. For instructions whose text
+// depends on pc (branches are printed with the target address), the
+// entry indexed by the bytes is only a mark, and the text is stored
+// in the entry indexed by both the bytes and pc.
+#define CACHE_SIZE 4096 // must be a power of 2
+#define CACHE_TEXT 48
+
+enum { ENTRY_INVALID, ENTRY_TEXT, ENTRY_PCREL, ENTRY_PCREL_TEXT };
+
+struct CacheEntry {
+  uint64_t code;
+  uint64_t pc;
+  uint8_t nbyte;
+  uint8_t kind;
+  char text[CACHE_TEXT];
+};
+
+static CacheEntry gCache[CACHE_SIZE];
+static uint64_t gHit = 0, gMiss = 0;
 
 extern "C" void init_disasm(const char *triple) {
   llvm::InitializeAllTargetInfos();
@@ -52,7 +75,6 @@ extern "C" void init_disasm(const char *triple) {
   std::string errstr;
   std::string gTriple(triple);
 
-  llvm::MCInstrInfo *gMII = nullptr;
   llvm::MCRegisterInfo *gMRI = nullptr;
   auto target = llvm::TargetRegistry::lookupTarget(gTriple, errstr);
   if (!target) {
@@ -87,7 +109,56 @@ extern "C" void init_disasm(const char *triple) {
   gIP->setPrintBranchImmAsAddress(true);
 }
 
+static int cache_idx(uint64_t code, uint64_t pc) {
+  uint64_t h = (code ^ (pc * 0x9e3779b97f4a7c15ull)) * 0xff51afd7ed558ccdull;
+  return (h >> 32) & (CACHE_SIZE - 1);
+}
+
+static bool is_pcrel(const MCInst &inst) {
+  const MCInstrDesc &desc = gMII->get(inst.getOpcode());
+  if (desc.isBranch() || desc.isCall()) return true;
+  for (const MCOperandInfo &op : desc.operands()) {
+    if (op.OperandType == MCOI::OPERAND_PCREL) return true;
+  }
+  return false;
+}
+
+static const char* cache_lookup(uint64_t code, uint64_t pc, int nbyte) {
+  CacheEntry *e = &gCache[cache_idx(code, 0)];
+  if (e->code != code || e->nbyte != nbyte) return nullptr;
+  if (e->kind == ENTRY_TEXT) return e->text;
+  if (e->kind != ENTRY_PCREL) return nullptr;
+  e = &gCache[cache_idx(code, pc)];
+  if (e->kind == ENTRY_PCREL_TEXT && e->code == code && e->nbyte == nbyte && e->pc == pc) return e->text;
+  return nullptr;
+}
+
+static void cache_fill(uint64_t code, uint64_t pc, int nbyte, bool pcrel, const char *text) {
+  if (strlen(text) >= CACHE_TEXT) return;
+  CacheEntry *e = &gCache[cache_idx(code, 0)];
+  *e = { code, 0, (uint8_t)nbyte, (uint8_t)(pcrel ? ENTRY_PCREL : ENTRY_TEXT), "" };
+  if (pcrel) {
+    e = &gCache[cache_idx(code, pc)];
+    *e = { code, pc, (uint8_t)nbyte, ENTRY_PCREL_TEXT, "" };
+  }
+  strcpy(e->text, text);
+}
+
 extern "C" void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte) {
+  uint64_t key = 0;
+  bool cacheable = (nbyte <= (int)sizeof(key));
+  if (cacheable) {
+    memcpy(&key, code, nbyte);
+    const char *text = cache_lookup(key, pc, nbyte);
+    if (text != nullptr) {
+      assert((int)strlen(text) < size);
+      strcpy(str, text);
+      gHit ++;
+      return;
+    }
+  }
+  gMiss ++;
+
   MCInst inst;
   llvm::ArrayRef<uint8_t> arr(code, nbyte);
   uint64_t dummy_size = 0;
@@ -101,4 +172,16 @@ extern "C" void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int
   const char *p = s.c_str() + skip;
   assert((int)s.length() - skip < size);
   strcpy(str, p);
+  if (cacheable) cache_fill(key, pc, nbyte, is_pcrel(inst), p);
+}
+
+extern "C" void disassemble_batch(int n, char *str[], int size, uint64_t pc[], uint8_t *code[], int nbyte[]) {
+  for (int i = 0; i < n; i ++) {
+    disassemble(str[i], size, pc[i], code[i], nbyte[i]);
+  }
+}
+
+extern "C" void disasm_cache_stat(uint64_t *hit, uint64_t *miss) {
+  *hit = gHit;
+  *miss = gMiss;
 }
@@ -0,0 +1,62 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+#include <common.h>
+
+#ifdef CONFIG_ITRACE
+#define ILEN_MAX MUXDEF(CONFIG_ISA_x86, 8, 4)
+
+void disassemble(char *str, int size, uint64_t pc, uint8_t *code, int nbyte);
+
+void itrace_format(char *buf, int size, vaddr_t pc, uint8_t *inst, int ilen) {
+  char *p = buf;
+  p += snprintf(p, size, FMT_WORD ":", pc);
+  int i;
+  for (i = ilen - 1; i >= 0; i --) {
+    p += snprintf(p, 4, " %02x", inst[i]);
+  }
+  int space_len = ILEN_MAX - ilen;
+  if (space_len < 0) space_len = 0;
+  space_len = space_len * 3 + 1;
+  memset(p, ' ', space_len);
+  p += space_len;
+
+  disassemble(p, buf + size - p, MUXDEF(CONFIG_ISA_x86, pc + ilen, pc), inst, ilen);
+}
+
+#ifdef CONFIG_IRINGBUF
+#define NR_IRINGBUF CONFIG_IRINGBUF_SIZE
+
+IRingBufEntry iringbuf[NR_IRINGBUF];
+int iringbuf_tail = 0;
+bool iringbuf_full = false;
+
+void iringbuf_dump() {
+  int n = (iringbuf_full ? NR_IRINGBUF : iringbuf_tail);
+  int i = (iringbuf_full ? iringbuf_tail : 0);
+  char buf[128];
+  printf("Recently executed instructions:\n");
+  log_write("Recently executed instructions:\n");
+  for (; n > 0; n --, i = (i + 1) % NR_IRINGBUF) {
+    IRingBufEntry *e = &iringbuf[i];
+    itrace_format(buf, sizeof(buf), e->pc, (uint8_t *)&e->inst, (e->ilen < ILEN_MAX ? e->ilen : ILEN_MAX));
+    const char *mark = (n == 1 ? " --> " : "     ");
+    printf("%s%s\n", mark, buf);
+    log_write("%s%s\n", mark, buf);
+  }
+}
+#endif
+#endif
@@ -18,6 +18,194 @@
 extern uint64_t g_nr_guest_inst;
 FILE *log_fp = NULL;
 
+#ifdef CONFIG_LOG_ASYNC
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <time.h>
+
+// Each thread formats messages into its own buffer. A full buffer is
+// pushed to a lock-free MPSC queue, and written by the writer thread.
+// The writer also asks the threads to hand over their buffers every
+// CONFIG_LOG_FLUSH_INTERVAL ms. The mutex is only used for sleeping.
+#define LOG_BUF_SIZE (64 * 1024)
+
+typedef struct LogBuf {
+  struct LogBuf *_Atomic next;
+  size_t size, cap;
+  char data[];
+} LogBuf;
+
+static LogBuf stub = {};
+static LogBuf *_Atomic head = &stub; // producers push here
+static LogBuf *tail = &stub;         // the writer pops here
+static _Atomic uint64_t nr_push = 0;
+static _Atomic bool flush_req = false;
+static uint64_t nr_done = 0;
+static bool stop = false;
+static bool async_on = false;
+
+static __thread LogBuf *cur = NULL;
+static pthread_key_t cur_key;
+static pthread_t writer;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t push_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+
+static void queue_push(LogBuf *b) {
+  atomic_store_explicit(&b->next, NULL, memory_order_relaxed);
+  LogBuf *prev = atomic_exchange_explicit(&head, b, memory_order_acq_rel);
+  atomic_store_explicit(&prev->next, b, memory_order_release);
+}
+
+static LogBuf* queue_pop() {
+  LogBuf *t = tail;
+  LogBuf *next = atomic_load_explicit(&t->next, memory_order_acquire);
+  if (t == &stub) {
+    if (next == NULL) return NULL;
+    tail = t = next;
+    next = atomic_load_explicit(&t->next, memory_order_acquire);
+  }
+  if (next != NULL) { tail = next; return t; }
+  // a producer is pushing after `t', retry later
+  if (t != atomic_load_explicit(&head, memory_order_acquire)) return NULL;
+  queue_push(&stub);
+  next = atomic_load_explicit(&t->next, memory_order_acquire);
+  if (next != NULL) { tail = next; return t; }
+  return NULL;
+}
+
+// hand over the buffer of the current thread, and
+// return the ticket to wait for it to be written
+static uint64_t handoff(LogBuf *b) {
+  queue_push(b);
+  uint64_t ticket = atomic_fetch_add(&nr_push, 1) + 1;
+  pthread_mutex_lock(&lock);
+  pthread_cond_signal(&push_cond);
+  pthread_mutex_unlock(&lock);
+  return ticket;
+}
+
+static void handoff_at_exit(void *b) {
+  handoff(b);
+}
+
+static LogBuf* new_buf(size_t cap) {
+  LogBuf *b = malloc(sizeof(LogBuf) + cap);
+  assert(b);
+  b->size = 0;
+  b->cap = cap;
+  return b;
+}
+
+static void* writer_main(void *arg) {
+  uint64_t nr_pop = 0;
+  while (true) {
+    pthread_mutex_lock(&lock);
+    if (atomic_load(&nr_push) == nr_pop && !stop) {
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_nsec += CONFIG_LOG_FLUSH_INTERVAL * 1000000L;
+      ts.tv_sec += ts.tv_nsec / 1000000000L;
+      ts.tv_nsec %= 1000000000L;
+      if (pthread_cond_timedwait(&push_cond, &lock, &ts) != 0) {
+        atomic_store_explicit(&flush_req, true, memory_order_relaxed);
+      }
+    }
+    bool exiting = stop && atomic_load(&nr_push) == nr_pop;
+    pthread_mutex_unlock(&lock);
+    if (exiting) break;
+
+    LogBuf *b;
+    int n = 0;
+    while ((b = queue_pop()) != NULL) {
+      fwrite(b->data, 1, b->size, log_fp);
+      free(b);
+      n ++;
+    }
+    if (n == 0) continue;
+    fflush(log_fp);
+    nr_pop += n;
+
+    pthread_mutex_lock(&lock);
+    nr_done = nr_pop;
+    pthread_cond_broadcast(&done_cond);
+    pthread_mutex_unlock(&lock);
+  }
+  return NULL;
+}
+
+void log_printf(const char *fmt, ...) {
+  if (!async_on) {
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(log_fp, fmt, ap);
+    va_end(ap);
+    fflush(log_fp);
+    return;
+  }
+
+  if (cur == NULL) {
+    cur = new_buf(LOG_BUF_SIZE);
+    pthread_setspecific(cur_key, cur);
+  }
+  while (true) {
+    va_list ap;
+    va_start(ap, fmt);
+    size_t left = cur->cap - cur->size;
+    size_t n = vsnprintf(cur->data + cur->size, left, fmt, ap);
+    va_end(ap);
+    if (n < left) { cur->size += n; break; }
+    // the message does not fit, hand over the buffer and retry
+    if (cur->size != 0) handoff(cur);
+    else free(cur);
+    cur = new_buf(n < LOG_BUF_SIZE ? LOG_BUF_SIZE : n + 1);
+    pthread_setspecific(cur_key, cur);
+  }
+
+  if (cur->size > cur->cap - 256 ||
+      atomic_load_explicit(&flush_req, memory_order_relaxed)) {
+    atomic_store_explicit(&flush_req, false, memory_order_relaxed);
+    handoff(cur);
+    cur = NULL;
+    pthread_setspecific(cur_key, NULL);
+  }
+}
+
+// write the messages of the current thread to the log file before returning
+void log_flush() {
+  if (!async_on || cur == NULL || cur->size == 0) return;
+  uint64_t ticket = handoff(cur);
+  cur = NULL;
+  pthread_setspecific(cur_key, NULL);
+  pthread_mutex_lock(&lock);
+  while (nr_done < ticket) pthread_cond_wait(&done_cond, &lock);
+  pthread_mutex_unlock(&lock);
+}
+
+static void log_close() {
+  log_flush();
+  pthread_mutex_lock(&lock);
+  stop = true;
+  pthread_cond_signal(&push_cond);
+  pthread_mutex_unlock(&lock);
+  pthread_join(writer, NULL);
+  async_on = false;
+  fflush(log_fp);
+}
+
+static void init_log_async() {
+  // keep writing synchronously to stdout, so that logs are
+  // not mixed up with other output of NEMU
+  if (log_fp == stdout) return;
+  pthread_key_create(&cur_key, handoff_at_exit);
+  int ret = pthread_create(&writer, NULL, writer_main, NULL);
+  Assert(ret == 0, "Can not create the log writer thread");
+  async_on = true;
+  atexit(log_close);
+}
+#endif
+
 void init_log(const char *log_file) {
   log_fp = stdout;
   if (log_file != NULL) {
@@ -25,10 +213,11 @@ void init_log(const char *log_file) {
     Assert(fp, "Can not open '%s'", log_file);
     log_fp = fp;
   }
+  IFDEF(CONFIG_LOG_ASYNC, init_log_async());
   Log("Log is written to %s", log_file ? log_file : "stdout");
 }
 
 bool log_enable() {
-  return MUXDEF(CONFIG_TRACE, (g_nr_guest_inst >= CONFIG_TRACE_START) &&
-         (g_nr_guest_inst <= CONFIG_TRACE_END), false);
+  return MUXDEF(CONFIG_TRACE, trace_in_window(g_nr_guest_inst), false);
 }
+
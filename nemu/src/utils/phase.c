@@ -0,0 +1,41 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <phase.h>
+
+#ifdef CONFIG_PHASE_PROF
+uint64_t g_phase_time[NR_PHASE] = {};
+uint64_t g_phase_last = 0;
+int g_phase_stack[PHASE_MAX_DEPTH] = { PHASE_IDLE };
+int g_phase_depth = 0;
+
+static const char *phase_name[NR_PHASE] = {
+  [PHASE_IDLE] = "idle", [PHASE_LOOP] = "loop", [PHASE_FETCH] = "fetch", [PHASE_EXEC] = "decode/exec",
+  [PHASE_MEM] = "memory", [PHASE_MMIO] = "mmio", [PHASE_DEVICE] = "device",
+  [PHASE_TRACE] = "trace/difftest",
+};
+
+void phase_report(uint64_t nr_inst) {
+  uint64_t total = 0;
+  int i;
+  for (i = PHASE_LOOP; i < NR_PHASE; i ++) total += g_phase_time[i];
+  if (total == 0 || nr_inst == 0) return;
+  Log("Host %s by phase:", PHASE_UNIT);
+  for (i = PHASE_LOOP; i < NR_PHASE; i ++) {
+    Log("%-14s %6.2f%% %10.2f %s/inst", phase_name[i], g_phase_time[i] * 100.0 / total,
+        (double)g_phase_time[i] / nr_inst, PHASE_UNIT);
+  }
+}
+#endif
@@ -0,0 +1,146 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+#include <common.h>
+
+#ifdef CONFIG_TIMELINE
+#include <time.h>
+
+// Events are kept in memory and written in the trace event format of
+// Chrome at exit, which can be opened by Perfetto or chrome://tracing.
+// Consecutive MMIO accesses to the same device are merged into a burst
+// if the gap between them is less than BURST_GAP.
+
+#define BURST_GAP 100000 // ns
+
+typedef struct {
+  const char *name;
+  uint64_t ts, dur, arg; // unit: ns
+  char ph;
+  uint8_t track;
+} Event;
+
+static Event *events = NULL;
+static uint32_t nr_event = 0, max_event = 0;
+static uint64_t nr_drop = 0;
+static uint64_t start_time = 0;
+static char *timeline_file = NULL;
+
+static const char *burst_name = NULL;
+static uint64_t burst_start = 0, burst_last = 0, burst_count = 0;
+
+static const char *track_name[] = { NULL, "guest", "device", "host" };
+
+uint64_t timeline_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void add(char ph, int track, const char *name, uint64_t ts, uint64_t dur, uint64_t arg) {
+  if (timeline_file == NULL) return;
+  if (nr_event == max_event) {
+    if (max_event == CONFIG_TIMELINE_MAX_EVENTS) { nr_drop ++; return; }
+    max_event = (max_event == 0 ? 4096 : max_event * 2);
+    if (max_event > CONFIG_TIMELINE_MAX_EVENTS) max_event = CONFIG_TIMELINE_MAX_EVENTS;
+    events = realloc(events, sizeof(Event) * max_event);
+    assert(events);
+  }
+  events[nr_event ++] = (Event) { .name = name, .ts = ts, .dur = dur, .arg = arg,
+    .ph = ph, .track = track };
+}
+
+// the clock is not read when the timeline is off,
+// since these are called on every function call and trap
+void timeline_begin(int track, const char *name) {
+  if (timeline_file == NULL) return;
+  add('B', track, name, timeline_now(), 0, 0);
+}
+
+void timeline_end(int track) {
+  if (timeline_file == NULL) return;
+  add('E', track, NULL, timeline_now(), 0, 0);
+}
+
+void timeline_instant(int track, const char *name, uint64_t arg) {
+  if (timeline_file == NULL) return;
+  add('i', track, name, timeline_now(), 0, arg);
+}
+
+// a span from `start' to now
+void timeline_span(int track, const char *name, uint64_t start, uint64_t arg) {
+  if (timeline_file == NULL) return;
+  add('X', track, name, start, timeline_now() - start, arg);
+}
+
+static void burst_flush() {
+  if (burst_name == NULL) return;
+  add('X', TL_DEVICE, burst_name, burst_start, burst_last - burst_start, burst_count);
+  burst_name = NULL;
+}
+
+void timeline_mmio(const char *name) {
+  if (timeline_file == NULL) return;
+  uint64_t now = timeline_now();
+  if (name != burst_name || now - burst_last >= BURST_GAP) {
+    burst_flush();
+    burst_name = name;
+    burst_start = now;
+    burst_count = 0;
+  }
+  burst_last = now;
+  burst_count ++;
+}
+
+static void timeline_write() {
+  burst_flush();
+  FILE *fp = fopen(timeline_file, "w");
+  Assert(fp, "Can not open '%s'", timeline_file);
+  fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  int i;
+  for (i = TL_GUEST; i <= TL_HOST; i ++) {
+    fprintf(fp, "%s{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %d, "
+        "\"args\": {\"name\": \"%s\"}}", (i == TL_GUEST ? "" : ",\n"), i, track_name[i]);
+  }
+  uint32_t j;
+  for (j = 0; j < nr_event; j ++) {
+    Event *e = &events[j];
+    uint64_t ts = e->ts - start_time;
+    fprintf(fp, ",\n{\"ph\": \"%c\", \"pid\": 1, \"tid\": %d, \"ts\": %" PRIu64 ".%03" PRIu64,
+        e->ph, e->track, ts / 1000, ts % 1000);
+    if (e->name != NULL) fprintf(fp, ", \"name\": \"%s\"", e->name);
+    switch (e->ph) {
+      case 'X': fprintf(fp, ", \"dur\": %" PRIu64 ".%03" PRIu64 ", \"args\": {\"count\": %" PRIu64 "}",
+                    e->dur / 1000, e->dur % 1000, e->arg); break;
+      case 'i': fprintf(fp, ", \"s\": \"t\", \"args\": {\"arg\": %" PRIu64 "}", e->arg); break;
+    }
+    fprintf(fp, "}");
+  }
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+  if (nr_drop > 0) Log("%" PRIu64 " events are dropped from the timeline", nr_drop);
+  free(events);
+  events = NULL;
+  timeline_file = NULL;
+}
+
+void init_timeline(char *file) {
+  if (file == NULL) return;
+  timeline_file = file;
+  start_time = timeline_now();
+  atexit(timeline_write);
+  Log("Timeline is written to %s at exit", file);
+}
+#endif
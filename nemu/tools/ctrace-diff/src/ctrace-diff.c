@@ -0,0 +1,266 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+// Check a commit trace recorded by NEMU with a reference design.
+// The trace is split into chunks at checkpoints, and each chunk is
+// checked by a child process with its own copy of the reference design.
+
+#include <isa.h>
+#include <memory/paddr.h>
+#include <difftest-def.h>
+#include <ctrace-def.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define PC_IDX (offsetof(CPU_state, pc) / sizeof(word_t))
+
+static void (*ref_difftest_memcpy)(paddr_t addr, void *buf, size_t n, bool direction) = NULL;
+static void (*ref_difftest_regcpy)(void *dut, bool direction) = NULL;
+static void (*ref_difftest_exec)(uint64_t n) = NULL;
+
+static char *ref_so_file = NULL;
+static char *trace_file = NULL;
+static int nr_worker = 0;
+static int port = 1234;
+
+static uint8_t *mem = NULL; // the memory of DUT at the current checkpoint
+static uint8_t *trace = NULL;
+static uint8_t *trace_end = NULL;
+
+static void init_ref() {
+  void *handle = dlopen(ref_so_file, RTLD_LAZY);
+  if (handle == NULL) {
+    printf("%s\n", dlerror());
+    exit(1);
+  }
+
+  ref_difftest_memcpy = dlsym(handle, "difftest_memcpy");
+  assert(ref_difftest_memcpy);
+
+  ref_difftest_regcpy = dlsym(handle, "difftest_regcpy");
+  assert(ref_difftest_regcpy);
+
+  ref_difftest_exec = dlsym(handle, "difftest_exec");
+  assert(ref_difftest_exec);
+
+  void (*ref_difftest_init)(int) = dlsym(handle, "difftest_init");
+  assert(ref_difftest_init);
+
+  ref_difftest_init(port);
+  ref_difftest_memcpy(CONFIG_MBASE, mem, CONFIG_MSIZE, DIFFTEST_TO_REF);
+}
+
+static void report_inst(uint64_t nr_inst, vaddr_t pc, uint8_t *inst, int ilen) {
+  printf("instruction #%" PRIu64 " at pc = " FMT_WORD ",", nr_inst, pc);
+  int i;
+  for (i = ilen - 1; i >= 0; i --) {
+    printf(" %02x", inst[i]);
+  }
+  printf("\n");
+}
+
+static void report_regs(CPU_state *ref, CPU_state *dut) {
+  word_t *r = (word_t *)ref, *d = (word_t *)dut;
+  int i;
+  for (i = 0; i < DIFFTEST_REG_SIZE / sizeof(word_t); i ++) {
+    if (r[i] == d[i]) continue;
+    char name[16];
+    if (i == PC_IDX) strcpy(name, "pc");
+    else sprintf(name, "reg[%d]", i);
+    printf("  %s is different, right = " FMT_WORD ", wrong = " FMT_WORD "\n", name, r[i], d[i]);
+  }
+}
+
+// check the records from the checkpoint at `p', and return the
+// number of the first different instruction, or 0 if there is none
+static uint64_t check_chunk(uint8_t *p, uint64_t nr_inst) {
+  CPU_state dut = {}, ref = {};
+  memcpy(&dut, p + 1, DIFFTEST_REG_SIZE);
+  p += 1 + DIFFTEST_REG_SIZE;
+  ref_difftest_regcpy(&dut, DIFFTEST_TO_REF);
+
+  while (p < trace_end) {
+    int type = *p ++;
+    if (type == CTRACE_CKPT || type == CTRACE_END) break;
+
+    CTraceInst rec;
+    memcpy(&rec, p, sizeof(rec));
+    p += sizeof(rec);
+    uint8_t *inst = p;
+    p += rec.ilen;
+    vaddr_t pc = dut.pc;
+    int i;
+    for (i = 0; i < rec.nr_reg; i ++) {
+      CTraceReg r;
+      memcpy(&r, p, sizeof(r));
+      p += sizeof(r);
+      ((word_t *)&dut)[r.idx] = r.val;
+    }
+    dut.pc = rec.npc;
+    CTraceStore *stores = (void *)p;
+    p += sizeof(CTraceStore) * rec.nr_store;
+    nr_inst ++;
+
+    if (type == CTRACE_SKIP) {
+      for (i = 0; i < rec.nr_store; i ++) {
+        word_t data = stores[i].data;
+        ref_difftest_memcpy(stores[i].addr, &data, stores[i].len, DIFFTEST_TO_REF);
+      }
+      ref_difftest_regcpy(&dut, DIFFTEST_TO_REF);
+      continue;
+    }
+
+    ref_difftest_exec(1);
+    ref_difftest_regcpy(&ref, DIFFTEST_TO_DUT);
+    if (memcmp(&ref, &dut, DIFFTEST_REG_SIZE) != 0) {
+      report_inst(nr_inst, pc, inst, rec.ilen);
+      report_regs(&ref, &dut);
+      return nr_inst;
+    }
+    for (i = 0; i < rec.nr_store; i ++) {
+      word_t right = 0, wrong = stores[i].data;
+      ref_difftest_memcpy(stores[i].addr, &right, stores[i].len, DIFFTEST_TO_DUT);
+      if (memcmp(&right, &wrong, stores[i].len) != 0) {
+        report_inst(nr_inst, pc, inst, rec.ilen);
+        printf("  memory at " FMT_PADDR " is different, right = " FMT_WORD ", wrong = " FMT_WORD "\n",
+            stores[i].addr, right, wrong);
+        return nr_inst;
+      }
+    }
+  }
+  return 0;
+}
+
+// skip the records until the next checkpoint, and
+// apply the memory writes to get the memory at that time
+static uint8_t* skip_chunk(uint8_t *p, uint64_t *nr_inst) {
+  p += 1 + DIFFTEST_REG_SIZE;
+  while (p < trace_end && *p != CTRACE_CKPT && *p != CTRACE_END) {
+    CTraceInst rec;
+    memcpy(&rec, p + 1, sizeof(rec));
+    p += 1 + sizeof(rec) + rec.ilen + sizeof(CTraceReg) * rec.nr_reg;
+    int i;
+    for (i = 0; i < rec.nr_store; i ++) {
+      CTraceStore s;
+      memcpy(&s, p, sizeof(s));
+      p += sizeof(s);
+      if (in_pmem(s.addr)) memcpy(mem + s.addr - CONFIG_MBASE, &s.data, s.len);
+    }
+    (*nr_inst) ++;
+  }
+  return p;
+}
+
+static void load_trace() {
+  int fd = open(trace_file, O_RDONLY);
+  if (fd < 0) {
+    perror(trace_file);
+    exit(1);
+  }
+  struct stat st;
+  fstat(fd, &st);
+  trace = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  assert(trace != MAP_FAILED);
+  trace_end = trace + st.st_size;
+  close(fd);
+
+  CTraceHeader h;
+  memcpy(&h, trace, sizeof(h));
+  if (h.magic != CTRACE_MAGIC || h.version != CTRACE_VERSION ||
+      h.word_size != sizeof(word_t) || h.reg_size != DIFFTEST_REG_SIZE) {
+    printf("%s is not a commit trace of " str(__GUEST_ISA__) "\n", trace_file);
+    exit(1);
+  }
+
+  mem = mmap(NULL, CONFIG_MSIZE, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  assert(mem != MAP_FAILED);
+  memcpy(mem + h.img_addr - CONFIG_MBASE, trace + sizeof(h), h.img_size);
+  trace += sizeof(h) + h.img_size;
+}
+
+static void parse_args(int argc, char *argv[]) {
+  const struct option table[] = {
+    {"jobs"     , required_argument, NULL, 'j'},
+    {"port"     , required_argument, NULL, 'p'},
+    {"help"     , no_argument      , NULL, 'h'},
+    {0          , 0                , NULL,  0 },
+  };
+  int o;
+  while ( (o = getopt_long(argc, argv, "hj:p:", table, NULL)) != -1) {
+    switch (o) {
+      case 'j': sscanf(optarg, "%d", &nr_worker); break;
+      case 'p': sscanf(optarg, "%d", &port); break;
+      default: optind = argc + 1; break;
+    }
+  }
+  if (optind + 2 != argc) {
+    printf("Usage: %s [OPTION...] REF_SO TRACE\n\n", argv[0]);
+    printf("\t-j,--jobs=N             check N chunks in parallel\n");
+    printf("\t-p,--port=PORT          pass PORT to the reference design\n");
+    printf("\n");
+    exit(0);
+  }
+  ref_so_file = argv[optind];
+  trace_file = argv[optind + 1];
+  if (nr_worker <= 0) nr_worker = sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+int main(int argc, char *argv[]) {
+  parse_args(argc, argv);
+  load_trace();
+  assert(*trace == CTRACE_CKPT);
+
+  uint8_t *p = trace;
+  uint64_t nr_inst = 0;
+  int nr_chunk = 0, nr_bad = 0, nr_running = 0, status;
+  while (p < trace_end && *p == CTRACE_CKPT) {
+    if (nr_running == nr_worker) {
+      wait(&status);
+      nr_bad += !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+      nr_running --;
+    }
+
+    fflush(stdout);
+    int pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+      // the child inherits the memory at this checkpoint
+      init_ref();
+      exit(check_chunk(p, nr_inst) == 0 ? 0 : 1);
+    }
+    nr_running ++;
+    nr_chunk ++;
+    p = skip_chunk(p, &nr_inst);
+  }
+
+  while (nr_running > 0) {
+    wait(&status);
+    nr_bad += !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    nr_running --;
+  }
+
+  printf("%d chunks, %" PRIu64 " instructions are checked, %d chunks are different\n",
+      nr_chunk, nr_inst, nr_bad);
+  return nr_bad != 0;
+}
@@ -20,8 +20,10 @@
 
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/time.h>
 #include <linux/kvm.h>
 
 /* CR0 bits */
@@ -35,6 +37,9 @@
 #define RFLAGS_AF  (1u << 4)
 #define RFLAGS_FIX_MASK (RFLAGS_ID | RFLAGS_AC | RFLAGS_RF | RFLAGS_TF | RFLAGS_AF)
 
+// if the guest runs natively for such a long time, it must go somewhere else
+#define RUN_TIMEOUT_US 100000
+
 struct vm {
   int sys_fd;
   int fd;
@@ -58,12 +63,11 @@ enum {
 
 static struct vm vm;
 static struct vcpu vcpu;
+static volatile sig_atomic_t run_timeout = false;
 
-// This should be called everytime after KVM_SET_REGS.
-// It seems that KVM_SET_REGS will clean the state of single step.
-static void kvm_set_step_mode(bool watch, uint32_t watch_addr) {
+static void kvm_set_debug_mode(bool step, bool watch, uint32_t watch_addr) {
   struct kvm_guest_debug debug = {};
-  debug.control = KVM_GUESTDBG_ENABLE | KVM_GUESTDBG_SINGLESTEP | KVM_GUESTDBG_USE_HW_BP;
+  debug.control = KVM_GUESTDBG_ENABLE | KVM_GUESTDBG_USE_HW_BP | (step ? KVM_GUESTDBG_SINGLESTEP : 0);
   debug.arch.debugreg[0] = watch_addr;
   debug.arch.debugreg[7] = (watch ? 0x1 : 0x0); // watch instruction fetch at `watch_addr`
   if (ioctl(vcpu.fd, KVM_SET_GUEST_DEBUG, &debug) < 0) {
@@ -72,6 +76,12 @@ static void kvm_set_step_mode(bool watch, uint32_t watch_addr) {
   }
 }
 
+// This should be called everytime after KVM_SET_REGS.
+// It seems that KVM_SET_REGS will clean the state of single step.
+static void kvm_set_step_mode(bool watch, uint32_t watch_addr) {
+  kvm_set_debug_mode(true, watch, watch_addr);
+}
+
 static void kvm_setregs(const struct kvm_regs *r) {
   if (ioctl(vcpu.fd, KVM_SET_REGS, r) < 0) {
     perror("KVM_SET_REGS");
@@ -327,6 +337,72 @@ static void kvm_exec(uint64_t n) {
   }
 }
 
+// If the signal arrives before KVM_RUN is entered, it does not interrupt
+// the ioctl, so also let the next KVM_RUN return at once with EINTR.
+static void alarm_handler(int sig) {
+  run_timeout = true;
+  vcpu.kvm_run->immediate_exit = 1;
+}
+
+// Run natively until the instruction at `pc' is about to be executed.
+// Return false if the guest halts or does not get there in time.
+static bool kvm_run_to(uint32_t pc) {
+  struct kvm_regs *r = &vcpu.kvm_run->s.regs.regs;
+  r->rflags &= ~RFLAGS_TF;
+  vcpu.kvm_run->kvm_dirty_regs = KVM_SYNC_X86_REGS;
+  kvm_set_debug_mode(false, true, pc);
+
+  struct itimerval timer = { .it_value = { .tv_usec = RUN_TIMEOUT_US } };
+  run_timeout = false;
+  setitimer(ITIMER_REAL, &timer, NULL);
+
+  bool ok = true;
+  while (true) {
+    if (run_timeout) { ok = false; break; }
+    if (ioctl(vcpu.fd, KVM_RUN, 0) < 0) {
+      if (errno == EINTR) continue;
+      perror("KVM_RUN");
+      assert(0);
+    }
+
+    if (vcpu.kvm_run->exit_reason == KVM_EXIT_DEBUG) break;
+    if (vcpu.kvm_run->exit_reason == KVM_EXIT_HLT) { ok = false; break; }
+    fprintf(stderr,	"Got exit_reason %d at pc = 0x%llx, expected KVM_EXIT_DEBUG (%d)\n",
+        vcpu.kvm_run->exit_reason, r->rip, KVM_EXIT_DEBUG);
+    assert(0);
+  }
+
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_REAL, &timer, NULL);
+  vcpu.kvm_run->immediate_exit = 0;
+
+  r->rflags |= RFLAGS_TF;
+  vcpu.kvm_run->kvm_dirty_regs = KVM_SYNC_X86_REGS;
+  kvm_set_step_mode(false, 0);
+  return ok;
+}
+
+// Let the guest arrive at `pc' for `nr_hit' times, running natively
+// between two arrivals. Special instructions are only patched in
+// single-step mode, so if any of them is run natively, DUT will find
+// a difference and check again with difftest_exec().
+static void kvm_exec_until(uint32_t pc, uint64_t nr_hit) {
+  struct kvm_regs *r = &vcpu.kvm_run->s.regs.regs;
+  while (nr_hit > 0) {
+    // step over the current instruction, since the
+    // breakpoint will be hit at once if it is at `pc'
+    kvm_exec(1);
+    if (vcpu.kvm_run->exit_reason == KVM_EXIT_HLT) return;
+    if (r->rip == pc && -- nr_hit == 0) return;
+
+    // the debug register is being used to catch the entry of interrupt
+    if (vcpu.int_wp_state != STATE_IDLE) continue;
+
+    if (!kvm_run_to(pc)) return;
+    nr_hit --;
+  }
+}
+
 static void run_protected_mode() {
   struct kvm_sregs sregs;
   kvm_getsregs(&sregs);
@@ -382,6 +458,14 @@ void difftest_exec(uint64_t n) {
   kvm_exec(n);
 }
 
+// this is optional, used by DUT to run a batch of
+// `n' instructions which ends at the `nr_hit'-th arrival at `pc'
+void difftest_exec_until(uint64_t n, uint64_t pc, uint64_t nr_hit) {
+  // single-step is faster if the guest arrives at `pc' frequently
+  if (nr_hit * 2 >= n) kvm_exec(n);
+  else kvm_exec_until(pc, nr_hit);
+}
+
 void difftest_raise_intr(word_t NO) {
   uint32_t pgate_vaddr = vcpu.kvm_run->s.regs.sregs.idt.base + NO * 8;
   uint32_t pgate = va2pa(pgate_vaddr);
@@ -402,7 +486,14 @@ void difftest_raise_intr(word_t NO) {
 }
 
 void difftest_init(int port) {
+  struct sigaction sa = { .sa_handler = alarm_handler };
+  int ret = sigaction(SIGALRM, &sa, NULL);
+  assert(ret == 0);
+
   vm_init(CONFIG_MSIZE);
+  // the timeout of kvm_run_to() relies on kvm_run->immediate_exit
+  ret = ioctl(vm.sys_fd, KVM_CHECK_EXTENSION, KVM_CAP_IMMEDIATE_EXIT);
+  Assert(ret > 0, "KVM_CAP_IMMEDIATE_EXIT is not supported");
   vcpu_init();
   run_protected_mode();
 }
@@ -20,28 +20,30 @@
 
 bool gdb_connect_qemu(int);
 bool gdb_memcpy_to_qemu(uint32_t, void *, int);
+bool gdb_memcpy_from_qemu(void *, uint32_t, int);
 bool gdb_getregs(union isa_gdb_regs *);
 bool gdb_setregs(union isa_gdb_regs *);
+bool gdb_setregs_part(void *, int);
 bool gdb_si();
 void gdb_exit();
 
 void init_isa();
 
 void difftest_memcpy(paddr_t addr, void *buf, size_t n, bool direction) {
-  assert(direction == DIFFTEST_TO_REF);
-  if (direction == DIFFTEST_TO_REF) {
-    bool ok = gdb_memcpy_to_qemu(addr, buf, n);
-    assert(ok == 1);
-  }
+  bool ok = (direction == DIFFTEST_TO_REF ?
+      gdb_memcpy_to_qemu(addr, buf, n) : gdb_memcpy_from_qemu(buf, addr, n));
+  assert(ok == 1);
 }
 
 void difftest_regcpy(void *dut, bool direction) {
-  union isa_gdb_regs qemu_r;
-  gdb_getregs(&qemu_r);
   if (direction == DIFFTEST_TO_REF) {
-    memcpy(&qemu_r, dut, DIFFTEST_REG_SIZE);
-    gdb_setregs(&qemu_r);
+    // the rest of the registers are kept by QEMU, no need to read them
+    bool ok = gdb_setregs_part(dut, DIFFTEST_REG_SIZE);
+    assert(ok == 1);
   } else {
+    union isa_gdb_regs qemu_r;
+    // this is free if the registers are cached
+    gdb_getregs(&qemu_r);
     memcpy(dut, &qemu_r, DIFFTEST_REG_SIZE);
   }
 }
@@ -17,25 +17,39 @@
 
 static struct gdb_conn *conn;
 
+// registers only change when QEMU executes instructions,
+// so we can cache them to save the round trips
+static union isa_gdb_regs regs_cache;
+static bool regs_cache_valid = false;
+
 bool gdb_connect_qemu(int port) {
   // connect to gdbserver on localhost port 1234
   while ((conn = gdb_begin_inet("127.0.0.1", port)) == NULL) {
     usleep(1);
   }
 
+  // do not wait for the acknowledgment of each packet
+  gdb_start_noack(conn);
+
   return true;
 }
 
+static int hex_encode_buf(char *dst, void *src, int len) {
+  int i;
+  for (i = 0; i < len; i ++) {
+    dst[i * 2]     = hex_encode(((uint8_t *)src)[i] >> 4);
+    dst[i * 2 + 1] = hex_encode(((uint8_t *)src)[i] & 0xf);
+  }
+  return len * 2;
+}
+
 static bool gdb_memcpy_to_qemu_small(uint32_t dest, void *src, int len) {
   char *buf = malloc(len * 2 + 128);
   assert(buf != NULL);
   int p = sprintf(buf, "M0x%x,%x:", dest, len);
-  int i;
-  for (i = 0; i < len; i ++) {
-    p += sprintf(buf + p, "%c%c", hex_encode(((uint8_t *)src)[i] >> 4), hex_encode(((uint8_t *)src)[i] & 0xf));
-  }
+  p += hex_encode_buf(buf + p, src, len);
 
-  gdb_send(conn, (const uint8_t *)buf, strlen(buf));
+  gdb_send(conn, (const uint8_t *)buf, p);
   free(buf);
 
   size_t size;
@@ -59,7 +73,42 @@ bool gdb_memcpy_to_qemu(uint32_t dest, void *src, int len) {
   return ok;
 }
 
+static bool gdb_memcpy_from_qemu_small(void *dest, uint32_t src, int len) {
+  char buf[32];
+  int p = sprintf(buf, "m0x%x,%x", src, len);
+  gdb_send(conn, (const uint8_t *)buf, p);
+
+  size_t size;
+  uint8_t *reply = gdb_recv(conn, &size);
+  bool ok = (size == len * 2);
+  int i;
+  for (i = 0; ok && i < len; i ++) {
+    ((uint8_t *)dest)[i] = gdb_decode_hex(reply[i * 2], reply[i * 2 + 1]);
+  }
+  free(reply);
+
+  return ok;
+}
+
+bool gdb_memcpy_from_qemu(void *dest, uint32_t src, int len) {
+  const int mtu = 1500;
+  bool ok = true;
+  while (len > mtu) {
+    ok &= gdb_memcpy_from_qemu_small(dest, src, mtu);
+    dest += mtu;
+    src += mtu;
+    len -= mtu;
+  }
+  ok &= gdb_memcpy_from_qemu_small(dest, src, len);
+  return ok;
+}
+
 bool gdb_getregs(union isa_gdb_regs *r) {
+  if (regs_cache_valid) {
+    *r = regs_cache;
+    return true;
+  }
+
   gdb_send(conn, (const uint8_t *)"g", 1);
   size_t size;
   uint8_t *reply = gdb_recv(conn, &size);
@@ -77,23 +126,21 @@ bool gdb_getregs(union isa_gdb_regs *r) {
 
   free(reply);
 
+  regs_cache = *r;
+  regs_cache_valid = true;
   return true;
 }
 
-bool gdb_setregs(union isa_gdb_regs *r) {
-  int len = sizeof(union isa_gdb_regs);
+// write the first `len' bytes of the registers,
+// QEMU keeps the registers which are not covered
+bool gdb_setregs_part(void *r, int len) {
   char *buf = malloc(len * 2 + 128);
   assert(buf != NULL);
   buf[0] = 'G';
 
-  void *src = r;
-  int p = 1;
-  int i;
-  for (i = 0; i < len; i ++) {
-    p += sprintf(buf + p, "%c%c", hex_encode(((uint8_t *)src)[i] >> 4), hex_encode(((uint8_t *)src)[i] & 0xf));
-  }
+  int p = 1 + hex_encode_buf(buf + 1, r, len);
 
-  gdb_send(conn, (const uint8_t *)buf, strlen(buf));
+  gdb_send(conn, (const uint8_t *)buf, p);
   free(buf);
 
   size_t size;
@@ -101,10 +148,20 @@ bool gdb_setregs(union isa_gdb_regs *r) {
   bool ok = !strcmp((const char*)reply, "OK");
   free(reply);
 
+  if (ok && regs_cache_valid) memcpy(&regs_cache, r, len);
+  else regs_cache_valid = false;
+  return ok;
+}
+
+bool gdb_setregs(union isa_gdb_regs *r) {
+  bool ok = gdb_setregs_part(r, sizeof(union isa_gdb_regs));
+  regs_cache = *r;
+  regs_cache_valid = ok;
   return ok;
 }
 
 bool gdb_si() {
+  regs_cache_valid = false;
   char buf[] = "vCont;s:1";
   gdb_send(conn, (const uint8_t *)buf, strlen(buf));
   size_t size;
@@ -0,0 +1,416 @@
+/***************************************************************************************
+* Copyright (c) 2014-2022 Zihao Yu, Nanjing University
+*
+* NEMU is licensed under Mulan PSL v2.
+* You can use this software according to the terms and conditions of the Mulan PSL v2.
+* You may obtain a copy of Mulan PSL v2 at:
+*          http://license.coscl.org.cn/MulanPSL2
+*
+* THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+* EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+* MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+*
+* See the Mulan PSL v2 for more details.
+***************************************************************************************/
+
+
+// Decode a binary trace recorded by NEMU. The selected blocks are
+// split into several parts, and each part is decoded by a child process
+// into a temporary file. The files are printed in order at last.
+// Instructions are disassembled in batches of BATCH.
+
+#include <common.h>
+#include <btrace-def.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define ILEN_MAX MUXDEF(CONFIG_ISA_x86, 8, 4)
+#define BATCH 256 // number of instructions disassembled at once
+
+typedef MUXDEF(CONFIG_ISA64, Elf64_Ehdr, Elf32_Ehdr) Elf_Ehdr;
+typedef MUXDEF(CONFIG_ISA64, Elf64_Shdr, Elf32_Shdr) Elf_Shdr;
+typedef MUXDEF(CONFIG_ISA64, Elf64_Sym , Elf32_Sym ) Elf_Sym;
+#define ELF_ST_TYPE MUXDEF(CONFIG_ISA64, ELF64_ST_TYPE, ELF32_ST_TYPE)
+
+void init_disasm(const char *triple);
+void disassemble_batch(int n, char *str[], int size, uint64_t pc[], uint8_t *code[], int nbyte[]);
+
+typedef struct {
+  word_t addr;
+  word_t size;
+  const char *name;
+} Symbol;
+
+typedef struct {
+  BTraceBlock h;
+  uint8_t *data;
+} Block;
+
+typedef struct {
+  int type;
+  word_t addr;
+  int len;
+  word_t data;
+  const char *name;
+} Access;
+
+typedef struct {
+  uint64_t nr_inst;
+  word_t pc;
+  uint8_t *inst;
+  int ilen;
+  int acc; // index of the first access in the pool
+  int nr_acc;
+} Line;
+
+static char *trace_file = NULL;
+static char *elf_file = NULL;
+static char *sym_name = NULL;
+static int nr_worker = 0;
+static word_t pc_lo = 0, pc_hi = (word_t)-1;
+static uint64_t inst_from = 0, inst_to = UINT64_MAX;
+
+static Symbol *syms = NULL;
+static int nr_sym = 0;
+static Block *blocks = NULL;
+static int nr_block = 0;
+
+// the instructions to print, and their memory and device accesses
+static Line lines[BATCH];
+static int nr_line = 0;
+static Access *pool = NULL;
+static int nr_pool = 0, pool_max = 0;
+
+static void* map_file(const char *file, size_t *size) {
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) {
+    perror(file);
+    exit(1);
+  }
+  struct stat st;
+  fstat(fd, &st);
+  void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  assert(p != MAP_FAILED);
+  close(fd);
+  *size = st.st_size;
+  return p;
+}
+
+static int cmp_sym(const void *a, const void *b) {
+  word_t x = ((Symbol *)a)->addr, y = ((Symbol *)b)->addr;
+  return (x > y) - (x < y);
+}
+
+static void load_elf() {
+  size_t size;
+  uint8_t *elf = map_file(elf_file, &size);
+  Elf_Ehdr *eh = (void *)elf;
+  if (memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+      eh->e_ident[EI_CLASS] != MUXDEF(CONFIG_ISA64, ELFCLASS64, ELFCLASS32)) {
+    printf("%s is not an ELF file of " str(__GUEST_ISA__) "\n", elf_file);
+    exit(1);
+  }
+  Elf_Shdr *sh = (void *)(elf + eh->e_shoff);
+  int i, j;
+  for (i = 0; i < eh->e_shnum; i ++) {
+    if (sh[i].sh_type != SHT_SYMTAB) continue;
+    Elf_Sym *sym = (void *)(elf + sh[i].sh_offset);
+    const char *strtab = (void *)(elf + sh[sh[i].sh_link].sh_offset);
+    int n = sh[i].sh_size / sizeof(Elf_Sym);
+    syms = malloc(sizeof(Symbol) * n);
+    assert(syms);
+    for (j = 0; j < n; j ++) {
+      if (ELF_ST_TYPE(sym[j].st_info) != STT_FUNC) continue;
+      syms[nr_sym ++] = (Symbol) { .addr = sym[j].st_value,
+        .size = sym[j].st_size, .name = strtab + sym[j].st_name };
+    }
+    break;
+  }
+  qsort(syms, nr_sym, sizeof(Symbol), cmp_sym);
+}
+
+static Symbol* find_sym(word_t pc) {
+  int lo = 0, hi = nr_sym - 1;
+  Symbol *ret = NULL;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (syms[mid].addr <= pc) { ret = &syms[mid]; lo = mid + 1; }
+    else hi = mid - 1;
+  }
+  return (ret != NULL && pc - ret->addr < ret->size ? ret : NULL);
+}
+
+static void load_trace() {
+  size_t size;
+  uint8_t *p = map_file(trace_file, &size);
+  uint8_t *end = p + size;
+  BTraceHeader h;
+  memcpy(&h, p, sizeof(h));
+  if (h.magic != BTRACE_MAGIC || h.version != BTRACE_VERSION || h.word_size != sizeof(word_t)) {
+    printf("%s is not a binary trace of " str(__GUEST_ISA__) "\n", trace_file);
+    exit(1);
+  }
+  p += sizeof(h);
+
+  // only keep the blocks overlapping the instruction window
+  int max = 1024;
+  blocks = malloc(sizeof(Block) * max);
+  while (p + sizeof(BTraceBlock) <= end) {
+    Block b;
+    memcpy(&b.h, p, sizeof(b.h));
+    b.data = p + sizeof(b.h);
+    p = b.data + b.h.size;
+    if (p > end) break; // truncated
+    if (b.h.first_inst + b.h.nr_inst <= inst_from || b.h.first_inst >= inst_to) continue;
+    if (nr_block == max) {
+      max *= 2;
+      blocks = realloc(blocks, sizeof(Block) * max);
+    }
+    blocks[nr_block ++] = b;
+  }
+}
+
+static void print_inst(FILE *fp, Line *l, const char *text) {
+  fprintf(fp, "%10" PRIu64 "  " FMT_WORD, l->nr_inst, l->pc);
+  Symbol *sym = (nr_sym > 0 ? find_sym(l->pc) : NULL);
+  if (sym != NULL) fprintf(fp, " <%s+0x%x>", sym->name, (int)(l->pc - sym->addr));
+  fprintf(fp, ":");
+  int i;
+  for (i = l->ilen - 1; i >= 0; i --) {
+    fprintf(fp, " %02x", l->inst[i]);
+  }
+  for (i = l->ilen; i < ILEN_MAX; i ++) {
+    fprintf(fp, "   ");
+  }
+  fprintf(fp, " %s\n", text);
+}
+
+static bool is_mem(int type) {
+  return type == BTRACE_MEM_R || type == BTRACE_MEM_W || type == BTRACE_MEM_X;
+}
+
+static void print_access(FILE *fp, Access *a) {
+  bool is_write = (a->type == BTRACE_MEM_W || a->type == BTRACE_DEV_W);
+  if (is_mem(a->type)) {
+    fprintf(fp, "%12s mem %c [" FMT_WORD "] (%d) = " FMT_WORD "\n",
+        "", (a->type == BTRACE_MEM_X ? 'x' : is_write ? 'w' : 'r'), a->addr, a->len, a->data);
+  } else {
+    fprintf(fp, "%12s dev %c [" FMT_WORD "] (%d) = " FMT_WORD " {%s}\n",
+        "", (is_write ? 'w' : 'r'), a->addr, a->len, a->data, a->name);
+  }
+}
+
+static void flush_lines(FILE *fp) {
+  static char text[BATCH][96];
+  char *str[BATCH];
+  uint64_t pc[BATCH];
+  uint8_t *code[BATCH];
+  int nbyte[BATCH];
+  int i, j;
+  for (i = 0; i < nr_line; i ++) {
+    str[i] = text[i];
+    pc[i] = MUXDEF(CONFIG_ISA_x86, lines[i].pc + lines[i].ilen, lines[i].pc);
+    code[i] = lines[i].inst;
+    nbyte[i] = lines[i].ilen;
+  }
+  disassemble_batch(nr_line, str, sizeof(text[0]), pc, code, nbyte);
+
+  for (i = 0; i < nr_line; i ++) {
+    print_inst(fp, &lines[i], text[i]);
+    for (j = 0; j < lines[i].nr_acc; j ++) {
+      print_access(fp, &pool[lines[i].acc + j]);
+    }
+  }
+  nr_line = 0;
+  nr_pool = 0;
+}
+
+static void decode_block(FILE *fp, Block *b, uint8_t *raw) {
+  uLongf raw_size = b->h.raw_size;
+  int ret = uncompress(raw, &raw_size, b->data, b->h.size);
+  assert(ret == Z_OK && raw_size == b->h.raw_size);
+
+  uint8_t *p = raw, *end = raw + raw_size;
+  uint64_t nr_inst = b->h.first_inst;
+  word_t next_pc = 0, last_addr = 0;
+  int acc = nr_pool; // accesses of the next instruction start here
+  while (p < end) {
+    int type = *p ++;
+    int64_t delta;
+    uint64_t v;
+    if (type == BTRACE_INST) {
+      p = btrace_get_sleb(p, &delta);
+      word_t pc = next_pc + delta;
+      int ilen = *p ++;
+      uint8_t *inst = p;
+      p += ilen;
+      next_pc = pc + ilen;
+      if (nr_inst >= inst_from && nr_inst < inst_to && pc >= pc_lo && pc < pc_hi) {
+        lines[nr_line ++] = (Line) { .nr_inst = nr_inst, .pc = pc, .inst = inst, .ilen = ilen,
+          .acc = acc, .nr_acc = nr_pool - acc };
+        if (nr_line == BATCH) flush_lines(fp);
+      } else {
+        nr_pool = acc;
+      }
+      acc = nr_pool;
+      nr_inst ++;
+      continue;
+    }
+
+    Access a = { .type = type };
+    if (is_mem(type)) {
+      p = btrace_get_sleb(p, &delta);
+      a.addr = last_addr = last_addr + delta;
+    } else {
+      assert(type == BTRACE_DEV_R || type == BTRACE_DEV_W);
+      p = btrace_get_uleb(p, &v);
+      a.addr = v;
+    }
+    a.len = *p ++;
+    p = btrace_get_uleb(p, &v);
+    a.data = v;
+    if (type == BTRACE_DEV_R || type == BTRACE_DEV_W) {
+      a.name = (char *)p;
+      p += strlen(a.name) + 1;
+    }
+    if (nr_pool == pool_max) {
+      pool_max = (pool_max == 0 ? 1024 : pool_max * 2);
+      pool = realloc(pool, sizeof(Access) * pool_max);
+      assert(pool);
+    }
+    pool[nr_pool ++] = a;
+  }
+  // instructions refer to the raw records, which are
+  // overwritten by the next block
+  flush_lines(fp);
+}
+
+static void decode_blocks(FILE *fp, int from, int to) {
+  uint32_t max = 0;
+  int i;
+  for (i = from; i < to; i ++) {
+    if (blocks[i].h.raw_size > max) max = blocks[i].h.raw_size;
+  }
+  uint8_t *raw = malloc(max);
+  assert(raw);
+  for (i = from; i < to; i ++) {
+    decode_block(fp, &blocks[i], raw);
+  }
+  free(raw);
+}
+
+static bool parse_range(const char *s, uint64_t *lo, uint64_t *hi) {
+  char *end;
+  *lo = strtoull(s, &end, 0);
+  if (*end != '-') return false;
+  *hi = strtoull(end + 1, &end, 0);
+  return *end == '\0';
+}
+
+static void parse_args(int argc, char *argv[]) {
+  const struct option table[] = {
+    {"elf"      , required_argument, NULL, 'e'},
+    {"pc"       , required_argument, NULL, 'p'},
+    {"sym"      , required_argument, NULL, 's'},
+    {"window"   , required_argument, NULL, 'w'},
+    {"jobs"     , required_argument, NULL, 'j'},
+    {"help"     , no_argument      , NULL, 'h'},
+    {0          , 0                , NULL,  0 },
+  };
+  int o;
+  uint64_t lo, hi;
+  bool bad = false;
+  while ( (o = getopt_long(argc, argv, "he:p:s:w:j:", table, NULL)) != -1) {
+    switch (o) {
+      case 'e': elf_file = optarg; break;
+      case 's': sym_name = optarg; break;
+      case 'j': sscanf(optarg, "%d", &nr_worker); break;
+      case 'p':
+        if (!(bad = !parse_range(optarg, &lo, &hi))) { pc_lo = lo; pc_hi = hi; }
+        break;
+      case 'w': bad = !parse_range(optarg, &inst_from, &inst_to); break;
+      default: bad = true; break;
+    }
+    if (bad) break;
+  }
+  if (bad || optind + 1 != argc || (sym_name != NULL && elf_file == NULL)) {
+    printf("Usage: %s [OPTION...] TRACE\n\n", argv[0]);
+    printf("\t-e,--elf=FILE           show symbols in the ELF FILE\n");
+    printf("\t-p,--pc=LO-HI           only show instructions with LO <= pc < HI\n");
+    printf("\t-s,--sym=NAME           only show instructions in function NAME (needs --elf)\n");
+    printf("\t-w,--window=FROM-TO     only show the FROM-th to (TO-1)-th instructions\n");
+    printf("\t-j,--jobs=N             decode with N processes\n");
+    printf("\n");
+    exit(0);
+  }
+  trace_file = argv[optind];
+  if (nr_worker <= 0) nr_worker = sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+int main(int argc, char *argv[]) {
+  parse_args(argc, argv);
+  if (elf_file != NULL) load_elf();
+  if (sym_name != NULL) {
+    int i;
+    for (i = 0; i < nr_sym; i ++) {
+      if (strcmp(syms[i].name, sym_name) == 0) break;
+    }
+    if (i == nr_sym) {
+      printf("Function %s is not found in %s\n", sym_name, elf_file);
+      return 1;
+    }
+    pc_lo = syms[i].addr;
+    pc_hi = syms[i].addr + syms[i].size;
+  }
+  load_trace();
+
+  init_disasm(
+    MUXDEF(CONFIG_ISA_x86,     "i686",
+    MUXDEF(CONFIG_ISA_mips32,  "mipsel",
+    MUXDEF(CONFIG_ISA_riscv32, "riscv32",
+    MUXDEF(CONFIG_ISA_riscv64, "riscv64", "bad")))) "-pc-linux-gnu"
+  );
+
+  if (nr_worker > nr_block) nr_worker = nr_block;
+  if (nr_worker <= 1) {
+    decode_blocks(stdout, 0, nr_block);
+    return 0;
+  }
+
+  FILE **out = malloc(sizeof(FILE *) * nr_worker);
+  int i, status, nr_bad = 0;
+  fflush(stdout);
+  for (i = 0; i < nr_worker; i ++) {
+    out[i] = tmpfile();
+    assert(out[i]);
+    int pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+      decode_blocks(out[i], (int64_t)nr_block * i / nr_worker, (int64_t)nr_block * (i + 1) / nr_worker);
+      fclose(out[i]);
+      exit(0);
+    }
+  }
+  for (i = 0; i < nr_worker; i ++) {
+    wait(&status);
+    nr_bad += !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  char buf[65536];
+  for (i = 0; i < nr_worker; i ++) {
+    rewind(out[i]);
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), out[i])) > 0) {
+      fwrite(buf, 1, n, stdout);
+    }
+    fclose(out[i]);
+  }
+  return nr_bad != 0;
+}